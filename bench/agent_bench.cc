@@ -0,0 +1,269 @@
+// Agent-level benchmarks that drive Enrichment and Source through the
+// phases of a material exchange. Every phase is timed on its own, so the
+// per-phase latency curves show which phase scales badly with the number
+// of requests (N) and feed lots (M). Benchmarks over both N and M are
+// registered once per fixed M, so that each complexity fit is over N only.
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+#include <utility>
+#include <vector>
+
+#include "env.h"
+#include "exchange_context.h"
+#include "test_context.h"
+
+#include "enrichment.h"
+#include "source.h"
+
+#include "bench_helpers.h"
+
+namespace flexmore {
+
+typedef std::vector<std::pair<cyclus::Trade<cyclus::Material>,
+                              cyclus::Material::Ptr> > Responses;
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+double Seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Adds n product requests of diverse enrichment levels to ec
+void AddProductRequests(cyclus::TestContext* tc,
+                        cyclus::ExchangeContext<cyclus::Material>* ec,
+                        int n) {
+  std::vector<cyclus::Material::Ptr> mats = bench::ProductMats(n, 8);
+  for (int i = 0; i < n; i++) {
+    ec->AddRequest(cyclus::Request<cyclus::Material>::Create(
+        mats[i], tc->trader(), "enr_u"));
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// args: M feed lots
+void BM_EnrichmentGetMatlRequests(benchmark::State& state) {
+  cyclus::TestContext tc;
+  Enrichment* e = bench::FeedFacility(&tc, state.range(0), 8);
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(e->GetMatlRequests());
+  }
+  state.SetComplexityN(state.range(0));
+  delete e;
+}
+BENCHMARK(BM_EnrichmentGetMatlRequests)->Range(16, 4096)->Complexity();
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// args: N product requests; m feed lots
+void BM_EnrichmentGetMatlBids(benchmark::State& state, int m) {
+  cyclus::TestContext tc;
+  Enrichment* e = bench::FeedFacility(&tc, m, 8);
+  cyclus::ExchangeContext<cyclus::Material> ec;
+  AddProductRequests(&tc, &ec, state.range(0));
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(e->GetMatlBids(ec.commod_requests));
+  }
+  state.SetComplexityN(state.range(0));
+  delete e;
+}
+BENCHMARK_CAPTURE(BM_EnrichmentGetMatlBids, m16, 16)
+    ->Range(16, 1024)
+    ->Complexity();
+BENCHMARK_CAPTURE(BM_EnrichmentGetMatlBids, m4096, 4096)
+    ->Range(16, 1024)
+    ->Complexity();
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// M feed suppliers bid on each of N feed requests of the facility.
+// args: N feed requests; m feed bids per request
+void BM_EnrichmentAdjustMatlPrefs(benchmark::State& state, int m) {
+  using cyclus::Bid;
+  using cyclus::Material;
+  using cyclus::Request;
+
+  cyclus::TestContext tc;
+  Enrichment* e = bench::FeedFacility(&tc, 1, 1);
+  std::vector<cyclus::Composition::Ptr> comps;
+  for (int i = 0; i < 8; i++) {
+    comps.push_back(bench::FeedComp(i, 8));
+  }
+  cyclus::PrefMap<Material>::type prefs;
+  for (int r = 0; r < state.range(0); r++) {
+    Request<Material>* req = Request<Material>::Create(
+        Material::CreateUntracked(1, comps[0]), e, "natu");
+    for (int b = 0; b < m; b++) {
+      Material::Ptr offer = Material::CreateUntracked(1, comps[b % 8]);
+      prefs[req][Bid<Material>::Create(req, offer, tc.trader())] = 1;
+    }
+  }
+  while (state.KeepRunning()) {
+    e->AdjustMatlPrefs(prefs);
+    EnrichmentBench::ResetScratch(e);
+  }
+  state.SetComplexityN(state.range(0));
+  delete e;
+}
+BENCHMARK_CAPTURE(BM_EnrichmentAdjustMatlPrefs, m16, 16)
+    ->Range(1, 64)
+    ->Complexity();
+BENCHMARK_CAPTURE(BM_EnrichmentAdjustMatlPrefs, m4096, 4096)
+    ->Range(1, 64)
+    ->Complexity();
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Every iteration answers N product trades from a fresh facility holding
+// M feed lots, only the GetMatlTrades call is timed.
+// args: N product trades; m feed lots
+void BM_EnrichmentGetMatlTrades(benchmark::State& state, int m) {
+  using cyclus::Bid;
+  using cyclus::Material;
+  using cyclus::Request;
+  using cyclus::Trade;
+
+  int n = state.range(0);
+  cyclus::TestContext tc;
+  std::vector<Material::Ptr> targets = bench::ProductMats(n, 8);
+  while (state.KeepRunning()) {
+    // 1 kg of 5% LEU needs less than 12 kg of feed at 0.65%
+    Enrichment* e = bench::FeedFacility(&tc, m, 8, 12.0 * n / m + 1);
+    std::vector<Trade<Material> > trades;
+    for (int i = 0; i < n; i++) {
+      Request<Material>* req =
+          Request<Material>::Create(targets[i], tc.trader(), "enr_u");
+      Bid<Material>* bid = Bid<Material>::Create(
+          req, EnrichmentBench::Offer(e, targets[i]), e);
+      trades.push_back(Trade<Material>(req, bid, 1));
+    }
+    Responses responses;
+
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    e->GetMatlTrades(trades, responses);
+    state.SetIterationTime(Seconds(start));
+
+    for (int i = 0; i < n; i++) {
+      delete trades[i].bid;
+      delete trades[i].request;
+    }
+    delete e;
+  }
+  state.SetComplexityN(n);
+}
+BENCHMARK_CAPTURE(BM_EnrichmentGetMatlTrades, m16, 16)
+    ->Range(16, 1024)
+    ->UseManualTime()
+    ->Complexity();
+BENCHMARK_CAPTURE(BM_EnrichmentGetMatlTrades, m4096, 4096)
+    ->Range(16, 1024)
+    ->UseManualTime()
+    ->Complexity();
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Every iteration accepts M feed lots into an empty facility.
+// args: M feed lots
+void BM_EnrichmentAcceptMatlTrades(benchmark::State& state) {
+  using cyclus::Bid;
+  using cyclus::Material;
+  using cyclus::Request;
+  using cyclus::Trade;
+
+  int m = state.range(0);
+  cyclus::TestContext tc;
+  Request<Material>* req = Request<Material>::Create(
+      Material::CreateUntracked(1, bench::FeedComp(0, 1)), tc.trader(),
+      "natu");
+  Bid<Material>* bid = Bid<Material>::Create(
+      req, Material::CreateUntracked(1, bench::FeedComp(0, 1)), tc.trader());
+  Trade<Material> trade(req, bid, 1);
+  while (state.KeepRunning()) {
+    Enrichment* e = bench::FeedFacility(&tc, 0, 1);
+    Responses responses;
+    for (int i = 0; i < m; i++) {
+      responses.push_back(std::make_pair(
+          trade, Material::CreateUntracked(1, bench::FeedComp(i, 8))));
+    }
+
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+    e->AcceptMatlTrades(responses);
+    state.SetIterationTime(Seconds(start));
+
+    delete e;
+  }
+  state.SetComplexityN(m);
+  delete bid;
+  delete req;
+}
+BENCHMARK(BM_EnrichmentAcceptMatlTrades)
+    ->Range(16, 4096)
+    ->UseManualTime()
+    ->Complexity();
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// args: N requests
+void BM_SourceGetMatlBids(benchmark::State& state) {
+  cyclus::TestContext tc;
+  tc.get()->AddRecipe("natu", bench::FeedComp(0, 1));
+  Source* s = new Source(tc.get());
+  SourceBench::SetUp(s, "natu", "natu");
+  s->Tick();
+
+  cyclus::ExchangeContext<cyclus::Material> ec;
+  for (int i = 0; i < state.range(0); i++) {
+    ec.AddRequest(cyclus::Request<cyclus::Material>::Create(
+        cyclus::Material::CreateUntracked(1, bench::FeedComp(0, 1)),
+        tc.trader(), "natu"));
+  }
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(s->GetMatlBids(ec.commod_requests));
+    SourceBench::ResetScratch(s);
+  }
+  state.SetComplexityN(state.range(0));
+  delete s;
+}
+BENCHMARK(BM_SourceGetMatlBids)->Range(16, 4096)->Complexity();
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// args: N trades
+void BM_SourceGetMatlTrades(benchmark::State& state) {
+  using cyclus::Bid;
+  using cyclus::Material;
+  using cyclus::Request;
+  using cyclus::Trade;
+
+  cyclus::TestContext tc;
+  tc.get()->AddRecipe("natu", bench::FeedComp(0, 1));
+  Source* s = new Source(tc.get());
+  SourceBench::SetUp(s, "natu", "natu");
+  s->Tick();
+
+  Material::Ptr mat = Material::CreateUntracked(1, bench::FeedComp(0, 1));
+  std::vector<Trade<Material> > trades;
+  for (int i = 0; i < state.range(0); i++) {
+    Request<Material>* req =
+        Request<Material>::Create(mat, tc.trader(), "natu");
+    trades.push_back(Trade<Material>(req, Bid<Material>::Create(req, mat, s),
+                                     1));
+  }
+  while (state.KeepRunning()) {
+    Responses responses;
+    s->GetMatlTrades(trades, responses);
+  }
+  state.SetComplexityN(state.range(0));
+  for (int i = 0; i < trades.size(); i++) {
+    delete trades[i].bid;
+    delete trades[i].request;
+  }
+  delete s;
+}
+BENCHMARK(BM_SourceGetMatlTrades)->Range(16, 4096)->Complexity();
+
+}  // namespace flexmore
+
+int main(int argc, char** argv) {
+  cyclus::Env::SetNucDataPath();
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
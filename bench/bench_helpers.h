@@ -0,0 +1,114 @@
+#ifndef FLEXMORE_BENCH_BENCH_HELPERS_H_
+#define FLEXMORE_BENCH_BENCH_HELPERS_H_
+
+#include <string>
+#include <vector>
+
+#include "cyclus.h"
+#include "test_context.h"
+
+#include "enrichment.h"
+#include "source.h"
+
+namespace flexmore {
+
+/// Gives the benchmarks access to the Enrichment internals they measure
+class EnrichmentBench {
+ public:
+  static void SetUp(Enrichment* e) {
+    e->feed_commod = "natu";
+    e->feed_recipe = "natu";
+    e->product_commod = "enr_u";
+    e->tails_commod = "tails";
+    e->tails_assay = 0.003;
+    e->SetMaxInventorySize(1e299);
+    e->SwuCapacity(1e299);
+  }
+
+  static void AddMat(Enrichment* e, cyclus::Material::Ptr m) {
+    e->AddMat_(m);
+  }
+
+  static double FeedAssay(Enrichment* e) { return e->FeedAssay(); }
+
+  static void InvalidateFeedTally(Enrichment* e) {
+    e->feed_tally_valid_ = false;
+  }
+
+  static cyclus::Material::Ptr Offer(Enrichment* e, cyclus::Material::Ptr m) {
+    return e->Offer_(m);
+  }
+
+  /// rewinds the scratch arena, as Tick does at every time step
+  static void ResetScratch(Enrichment* e) { e->scratch_.Reset(); }
+};
+
+/// Gives the benchmarks access to the Source internals they set up
+class SourceBench {
+ public:
+  static void SetUp(Source* s, std::string commod, std::string recipe) {
+    s->outcommod = commod;
+    s->outrecipe = recipe;
+    s->throughput = std::vector<double>(1, 1e299);
+  }
+
+  /// rewinds the scratch arena, as Tick does at every time step
+  static void ResetScratch(Source* s) { s->scratch_.Reset(); }
+};
+
+namespace bench {
+
+/// @returns a natural uranium feed composition whose U-235 content varies
+/// slightly with i, cycling through diversity distinct compositions
+inline cyclus::Composition::Ptr FeedComp(int i, int diversity) {
+  double assay = 0.0065 + 0.0001 * (i % diversity);
+  cyclus::CompMap m;
+  m[922350000] = assay;
+  m[922380000] = 1 - assay;
+  return cyclus::Composition::CreateFromMass(m);
+}
+
+/// @returns a LEU product composition cycling through diversity distinct
+/// enrichment levels between 3% and 5%
+inline cyclus::Composition::Ptr ProductComp(int i, int diversity) {
+  double assay = 0.03 + 0.02 * (i % diversity) / diversity;
+  cyclus::CompMap m;
+  m[922350000] = assay;
+  m[922380000] = 1 - assay;
+  return cyclus::Composition::CreateFromMass(m);
+}
+
+/// @returns n product materials of unit quantity drawn from diversity
+/// distinct compositions. Compositions are created once per level so that
+/// materials of the same level share them, as recipe requests do.
+inline std::vector<cyclus::Material::Ptr> ProductMats(int n, int diversity) {
+  std::vector<cyclus::Composition::Ptr> comps;
+  for (int i = 0; i < diversity; i++) {
+    comps.push_back(ProductComp(i, diversity));
+  }
+  std::vector<cyclus::Material::Ptr> mats;
+  for (int i = 0; i < n; i++) {
+    mats.push_back(
+        cyclus::Material::CreateUntracked(1, comps[i % diversity]));
+  }
+  return mats;
+}
+
+/// @returns an Enrichment facility holding nlots feed lots of lot_qty each,
+/// drawn from diversity distinct compositions
+inline Enrichment* FeedFacility(cyclus::TestContext* tc, int nlots,
+                                int diversity, double lot_qty = 10) {
+  tc->get()->AddRecipe("natu", FeedComp(0, 1));
+  Enrichment* e = new Enrichment(tc->get());
+  EnrichmentBench::SetUp(e);
+  for (int i = 0; i < nlots; i++) {
+    EnrichmentBench::AddMat(e, cyclus::Material::CreateUntracked(
+        lot_qty, FeedComp(i, diversity)));
+  }
+  return e;
+}
+
+}  // namespace bench
+}  // namespace flexmore
+
+#endif  // FLEXMORE_BENCH_BENCH_HELPERS_H_
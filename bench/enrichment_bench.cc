@@ -0,0 +1,230 @@
+// Microbenchmarks of the Enrichment kernels. Run with
+// --benchmark_format=json for output that can be diffed across versions.
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include "env.h"
+#include "test_context.h"
+
+#include "enrichment.h"
+#include "uranium_view.h"
+
+#include "bench_helpers.h"
+
+namespace flexmore {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// args: number of requests, composition diversity, cached (0/1)
+void BM_SWUConverter(benchmark::State& state) {
+  std::vector<cyclus::Material::Ptr> mats =
+      bench::ProductMats(state.range(0), state.range(1));
+  ConversionCache::Ptr cache;
+  if (state.range(2)) {
+    cache.reset(new ConversionCache());
+  }
+  SWUConverter conv(0.0072, 0.003, cache);
+  while (state.KeepRunning()) {
+    for (int i = 0; i < mats.size(); i++) {
+      benchmark::DoNotOptimize(conv.convert(mats[i]));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * mats.size());
+}
+BENCHMARK(BM_SWUConverter)->Ranges({{16, 1024}, {1, 64}, {0, 1}});
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// args: number of requests, composition diversity, cached (0/1)
+void BM_NatUConverter(benchmark::State& state) {
+  std::vector<cyclus::Material::Ptr> mats =
+      bench::ProductMats(state.range(0), state.range(1));
+  ConversionCache::Ptr cache;
+  if (state.range(2)) {
+    cache.reset(new ConversionCache());
+  }
+  NatUConverter conv(0.0072, 0.003, cache);
+  while (state.KeepRunning()) {
+    for (int i = 0; i < mats.size(); i++) {
+      benchmark::DoNotOptimize(conv.convert(mats[i]));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * mats.size());
+}
+BENCHMARK(BM_NatUConverter)->Ranges({{16, 1024}, {1, 64}, {0, 1}});
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// args: number of inventory lots, composition diversity
+void BM_FeedAssay(benchmark::State& state) {
+  cyclus::TestContext tc;
+  Enrichment* e = bench::FeedFacility(&tc, state.range(0), state.range(1));
+  while (state.KeepRunning()) {
+    benchmark::DoNotOptimize(EnrichmentBench::FeedAssay(e));
+  }
+  delete e;
+}
+BENCHMARK(BM_FeedAssay)->Ranges({{1, 4096}, {1, 64}});
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// The feed assay after the tallies were invalidated, i.e. the cost of the
+// full pass over the inventory buffer.
+// args: number of inventory lots, composition diversity
+void BM_FeedAssayRebuild(benchmark::State& state) {
+  cyclus::TestContext tc;
+  Enrichment* e = bench::FeedFacility(&tc, state.range(0), state.range(1));
+  while (state.KeepRunning()) {
+    EnrichmentBench::InvalidateFeedTally(e);
+    benchmark::DoNotOptimize(EnrichmentBench::FeedAssay(e));
+  }
+  delete e;
+}
+BENCHMARK(BM_FeedAssayRebuild)->Ranges({{1, 4096}, {1, 64}});
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// args: number of requests, composition diversity
+void BM_Offer(benchmark::State& state) {
+  cyclus::TestContext tc;
+  Enrichment* e = bench::FeedFacility(&tc, 1, 1);
+  std::vector<cyclus::Material::Ptr> reqs =
+      bench::ProductMats(state.range(0), state.range(1));
+  while (state.KeepRunning()) {
+    for (int i = 0; i < reqs.size(); i++) {
+      benchmark::DoNotOptimize(EnrichmentBench::Offer(e, reqs[i]));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * reqs.size());
+  delete e;
+}
+BENCHMARK(BM_Offer)->Ranges({{16, 1024}, {1, 64}});
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// args: number of requests, composition diversity
+void BM_ValidReq(benchmark::State& state) {
+  cyclus::TestContext tc;
+  Enrichment* e = bench::FeedFacility(&tc, 1, 1);
+  std::vector<cyclus::Material::Ptr> reqs =
+      bench::ProductMats(state.range(0), state.range(1));
+  while (state.KeepRunning()) {
+    for (int i = 0; i < reqs.size(); i++) {
+      benchmark::DoNotOptimize(e->ValidReq(reqs[i]));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * reqs.size());
+  delete e;
+}
+BENCHMARK(BM_ValidReq)->Ranges({{16, 1024}, {1, 64}});
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Preference sorting of feed bids (SortBids) through AdjustMatlPrefs.
+// args: number of feed requests, bids per request, composition diversity
+void BM_SortBids(benchmark::State& state) {
+  using cyclus::Bid;
+  using cyclus::Material;
+  using cyclus::Request;
+
+  cyclus::TestContext tc;
+  Enrichment* e = bench::FeedFacility(&tc, 1, 1);
+  int diversity = state.range(2);
+  std::vector<cyclus::Composition::Ptr> comps;
+  for (int i = 0; i < diversity; i++) {
+    comps.push_back(bench::FeedComp(i, diversity));
+  }
+
+  cyclus::PrefMap<Material>::type prefs;
+  for (int r = 0; r < state.range(0); r++) {
+    Request<Material>* req = Request<Material>::Create(
+        Material::CreateUntracked(1, comps[0]), e, "natu");
+    for (int b = 0; b < state.range(1); b++) {
+      Material::Ptr offer =
+          Material::CreateUntracked(1, comps[(r + b) % diversity]);
+      prefs[req][Bid<Material>::Create(req, offer, tc.trader())] = 1;
+    }
+  }
+
+  while (state.KeepRunning()) {
+    e->AdjustMatlPrefs(prefs);
+    EnrichmentBench::ResetScratch(e);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0) *
+                          state.range(1));
+  delete e;
+}
+BENCHMARK(BM_SortBids)->Ranges({{1, 64}, {8, 512}, {1, 64}});
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Reading the U-235 and U-238 fractions of product materials through
+// MatQuery, as the hot paths did before UraniumView.
+// args: number of materials, composition diversity
+void BM_MatQueryUranium(benchmark::State& state) {
+  std::vector<cyclus::Material::Ptr> mats =
+      bench::ProductMats(state.range(0), state.range(1));
+  while (state.KeepRunning()) {
+    for (int i = 0; i < mats.size(); i++) {
+      cyclus::toolkit::MatQuery q(mats[i]);
+      benchmark::DoNotOptimize(q.atom_frac(922350000));
+      benchmark::DoNotOptimize(q.atom_frac(922380000));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * mats.size());
+}
+BENCHMARK(BM_MatQueryUranium)->Ranges({{16, 1024}, {1, 64}});
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// The same reads through UraniumAtomView.
+// args: number of materials, composition diversity
+void BM_UraniumView(benchmark::State& state) {
+  std::vector<cyclus::Material::Ptr> mats =
+      bench::ProductMats(state.range(0), state.range(1));
+  while (state.KeepRunning()) {
+    for (int i = 0; i < mats.size(); i++) {
+      UraniumAtomView u(mats[i]);
+      benchmark::DoNotOptimize(u.u235());
+      benchmark::DoNotOptimize(u.u238());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * mats.size());
+}
+BENCHMARK(BM_UraniumView)->Ranges({{16, 1024}, {1, 64}});
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// SWU and feed of n enrichments, one at a time through the toolkit.
+// args: number of enrichments
+void BM_SwuScalar(benchmark::State& state) {
+  std::vector<double> assays;
+  for (int i = 0; i < state.range(0); i++) {
+    assays.push_back(0.03 + 0.02 * (i % 8) / 8);
+  }
+  while (state.KeepRunning()) {
+    for (int i = 0; i < assays.size(); i++) {
+      cyclus::toolkit::Assays a(0.0072, assays[i], 0.003);
+      benchmark::DoNotOptimize(cyclus::toolkit::SwuRequired(1, a));
+      benchmark::DoNotOptimize(cyclus::toolkit::FeedQty(1, a));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * assays.size());
+}
+BENCHMARK(BM_SwuScalar)->Range(16, 4096);
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// The same enrichments through one EnrichmentBatch.
+// args: number of enrichments
+void BM_SwuBatch(benchmark::State& state) {
+  EnrichmentBatch batch;
+  for (int i = 0; i < state.range(0); i++) {
+    batch.Add(1, 0.03 + 0.02 * (i % 8) / 8);
+  }
+  while (state.KeepRunning()) {
+    batch.Compute(0.0072, 0.003);
+    benchmark::DoNotOptimize(batch.swu[0]);
+  }
+  state.SetItemsProcessed(state.iterations() * batch.size());
+}
+BENCHMARK(BM_SwuBatch)->Range(16, 4096);
+
+}  // namespace flexmore
+
+int main(int argc, char** argv) {
+  cyclus::Env::SetNucDataPath();
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
@@ -0,0 +1,176 @@
+#! /usr/bin/env python
+"""Writes synthetic Cyclus input files with many flexmore:Source suppliers,
+flexmore:Enrichment plants and matching consumers, to benchmark how the
+flexmore archetypes scale.
+"""
+import random
+import sys
+
+try:
+    import argparse as ap
+except ImportError:
+    import pyne._argparse as ap
+
+# U-235 mass fractions of the generated feed and product recipes
+FEED_ASSAYS = (0.0065, 0.0075)
+PRODUCT_ASSAYS = (0.03, 0.05)
+
+
+def spread(bounds, i, n):
+    """Returns the i-th of n values evenly spaced within bounds."""
+    if n == 1:
+        return bounds[0]
+    return bounds[0] + (bounds[1] - bounds[0]) * i / float(n - 1)
+
+
+def recipe(name, u235):
+    return ('  <recipe>\n'
+            '    <name>{0}</name>\n'
+            '    <basis>mass</basis>\n'
+            '    <nuclide> <id>U235</id> <comp>{1!r}</comp> </nuclide>\n'
+            '    <nuclide> <id>U238</id> <comp>{2!r}</comp> </nuclide>\n'
+            '  </recipe>\n').format(name, u235, 1 - u235)
+
+
+def schedule(tag, base, length, duration, rng):
+    """Returns a list input fluctuating around base with a period of length
+    time steps. A length of 1 gives a single, constant value; otherwise the
+    period is repeated or truncated to cover the duration."""
+    vals = [base]
+    for _ in range(min(length, duration) - 1):
+        vals.append(round(base * rng.uniform(0.8, 1.2), 3))
+    if len(vals) > 1:
+        vals = [vals[t % len(vals)] for t in range(duration)]
+    return '<{0}>{1}</{0}>'.format(
+        tag, ''.join('<val>{0!r}</val>'.format(v) for v in vals))
+
+
+def facility(name, archetype, body):
+    return ('  <facility>\n'
+            '    <name>{0}</name>\n'
+            '    <config><{1}>{2}</{1}></config>\n'
+            '  </facility>\n').format(name, archetype, body)
+
+
+def generate(args):
+    """Returns the Cyclus input file for the given arguments as a string."""
+    rng = random.Random(args.seed)
+    sched_len = max(args.schedule_length, 1)
+    nproto = args.recipes
+    out = []
+    out.append('<simulation>\n'
+               '  <control>\n'
+               '    <duration>{0}</duration>\n'
+               '    <startmonth>1</startmonth>\n'
+               '    <startyear>2000</startyear>\n'
+               '  </control>\n'
+               '  <archetypes>\n'
+               '    <spec><lib>flexmore</lib><name>Source</name></spec>\n'
+               '    <spec><lib>flexmore</lib><name>Enrichment</name></spec>\n'
+               '    <spec><lib>agents</lib><name>Sink</name></spec>\n'
+               '    <spec><lib>agents</lib><name>NullRegion</name></spec>\n'
+               '    <spec><lib>agents</lib><name>NullInst</name></spec>\n'
+               '  </archetypes>\n'.format(args.duration))
+
+    for i in range(nproto):
+        src = '<outcommod>natu</outcommod><outrecipe>natu_{0}</outrecipe>'
+        src = src.format(i) + schedule('throughput', args.source_throughput,
+                                       sched_len, args.duration, rng)
+        out.append(facility('mine_{0}'.format(i), 'Source', src))
+
+        enr = ('<feed_commod>natu</feed_commod>'
+               '<feed_recipe>natu_{0}</feed_recipe>'
+               '<product_commod>enr_u</product_commod>'
+               '<tails_commod>tails</tails_commod>'
+               '<tails_assay>0.003</tails_assay>'
+               '<max_feed_inventory>{1!r}</max_feed_inventory>').format(
+                   i, 10 * args.source_throughput)
+        enr += schedule('swu_vector', args.swu_capacity, sched_len,
+                        args.duration, rng)
+        out.append(facility('enrichment_{0}'.format(i), 'Enrichment', enr))
+
+        sink = ('<in_commods><val>enr_u</val></in_commods>'
+                '<recipe_name>leu_{0}</recipe_name>'
+                '<capacity>{1!r}</capacity>').format(i, args.sink_capacity)
+        out.append(facility('reactor_{0}'.format(i), 'Sink', sink))
+
+    out.append(facility('tails_store', 'Sink',
+                        '<in_commods><val>tails</val></in_commods>'))
+
+    def count(total, i):
+        return total // nproto + (1 if i < total % nproto else 0)
+
+    entries = []
+    for kind, total in (('mine', args.sources),
+                        ('enrichment', args.enrichments),
+                        ('reactor', args.sinks)):
+        for i in range(nproto):
+            n = count(total, i)
+            if n > 0:
+                entries.append((kind + '_{0}'.format(i), n))
+    entries.append(('tails_store', args.tails_sinks))
+    out.append('  <region>\n'
+               '    <name>region</name>\n'
+               '    <config><NullRegion/></config>\n'
+               '    <institution>\n'
+               '      <name>institution</name>\n'
+               '      <initialfacilitylist>\n')
+    for proto, n in entries:
+        out.append('        <entry><prototype>{0}</prototype>'
+                   '<number>{1}</number></entry>\n'.format(proto, n))
+    out.append('      </initialfacilitylist>\n'
+               '      <config><NullInst/></config>\n'
+               '    </institution>\n'
+               '  </region>\n')
+
+    for i in range(nproto):
+        out.append(recipe('natu_{0}'.format(i), spread(FEED_ASSAYS, i, nproto)))
+        out.append(recipe('leu_{0}'.format(i),
+                          spread(PRODUCT_ASSAYS, i, nproto)))
+    out.append('</simulation>\n')
+    return ''.join(out)
+
+
+def add_arguments(parser):
+    parser.add_argument('--sources', type=int, default=2000,
+                        help='the number of flexmore:Source suppliers')
+    parser.add_argument('--enrichments', type=int, default=200,
+                        help='the number of flexmore:Enrichment plants')
+    parser.add_argument('--sinks', type=int, default=400,
+                        help='the number of enriched uranium consumers')
+    parser.add_argument('--tails-sinks', type=int, default=4,
+                        help='the number of tails consumers')
+    parser.add_argument('--duration', type=int, default=120,
+                        help='the simulation duration in time steps')
+    parser.add_argument('--schedule-length', type=int, default=1,
+                        help='the period in time steps of the throughput and '
+                        'SWU schedules, 1 for constant schedules')
+    parser.add_argument('--recipes', type=int, default=4,
+                        help='the number of distinct feed and product '
+                        'recipes (and prototypes per archetype)')
+    parser.add_argument('--source-throughput', type=float, default=1000.0,
+                        help='the throughput of each source (kg/time step)')
+    parser.add_argument('--swu-capacity', type=float, default=5000.0,
+                        help='the SWU capacity of each enrichment plant')
+    parser.add_argument('--sink-capacity', type=float, default=50.0,
+                        help='the demand of each consumer (kg/time step)')
+    parser.add_argument('--seed', type=int, default=0,
+                        help='the seed of the schedule fluctuations')
+
+
+def main():
+    parser = ap.ArgumentParser(description=__doc__)
+    add_arguments(parser)
+    parser.add_argument('-o', '--output', default='-',
+                        help='the input file to write, - for stdout')
+    args = parser.parse_args()
+    xml = generate(args)
+    if args.output == '-':
+        sys.stdout.write(xml)
+    else:
+        with open(args.output, 'w') as f:
+            f.write(xml)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,94 @@
+#! /usr/bin/env python
+"""Generates scenarios of growing size, runs them with Cyclus and records
+the wall time of every time step, the peak resident set size and the size
+of the output database. Linux only (uses os.wait4 for per-run resource
+usage).
+"""
+import json
+import os
+import re
+import subprocess
+import sys
+import time
+
+try:
+    import argparse as ap
+except ImportError:
+    import pyne._argparse as ap
+
+import gen_scenario
+
+# Cyclus logs this line at the start of every time step at verbosity >= 2
+TIMESTEP_RE = re.compile(r'Current time:\s*(-?\d+)')
+
+
+def run(args, scale, workdir):
+    """Runs one scenario scaled by scale and returns its measurements."""
+    scen = ap.Namespace(**vars(args))
+    scen.sources = int(args.sources * scale)
+    scen.enrichments = max(1, int(args.enrichments * scale))
+    scen.sinks = max(1, int(args.sinks * scale))
+    infile = os.path.join(workdir, 'scaling_{0}.xml'.format(scale))
+    outfile = os.path.join(workdir, 'scaling_{0}.sqlite'.format(scale))
+    with open(infile, 'w') as f:
+        f.write(gen_scenario.generate(scen))
+    if os.path.exists(outfile):
+        os.remove(outfile)
+
+    cmd = [args.cyclus, '-v', '2', '-o', outfile, infile]
+    start = time.time()
+    proc = subprocess.Popen(cmd, stdout=subprocess.PIPE,
+                            stderr=subprocess.STDOUT,
+                            universal_newlines=True)
+    step_starts = []
+    for line in proc.stdout:
+        if TIMESTEP_RE.search(line):
+            step_starts.append(time.time())
+    proc.stdout.close()
+    _, status, usage = os.wait4(proc.pid, 0)
+    proc.returncode = os.WEXITSTATUS(status)
+    end = time.time()
+    if proc.returncode != 0:
+        sys.exit('cyclus failed on {0}'.format(infile))
+
+    step_ends = step_starts[1:] + [end]
+    return {
+        'scale': scale,
+        'sources': scen.sources,
+        'enrichments': scen.enrichments,
+        'sinks': scen.sinks,
+        'duration': scen.duration,
+        'wall_time_s': end - start,
+        'timestep_wall_time_s': [e - s for s, e in zip(step_starts, step_ends)],
+        'peak_rss_kb': usage.ru_maxrss,
+        'output_db_bytes': os.path.getsize(outfile),
+    }
+
+
+def main():
+    parser = ap.ArgumentParser(description=__doc__)
+    gen_scenario.add_arguments(parser)
+    parser.add_argument('--scales', type=float, nargs='+',
+                        default=[0.125, 0.25, 0.5, 1.0],
+                        help='the factors applied to the number of sources, '
+                        'enrichment plants and consumers')
+    parser.add_argument('--cyclus', default='cyclus',
+                        help='the cyclus executable')
+    parser.add_argument('--workdir', default='.',
+                        help='where to write inputs and output databases')
+    parser.add_argument('-o', '--output', default='scaling.json',
+                        help='the JSON file to write the results to')
+    args = parser.parse_args()
+
+    results = []
+    for scale in args.scales:
+        r = run(args, scale, args.workdir)
+        print('scale {0}: {1:.1f} s, {2} kB peak RSS, {3} B output'.format(
+            scale, r['wall_time_s'], r['peak_rss_kb'], r['output_db_bytes']))
+        results.append(r)
+    with open(args.output, 'w') as f:
+        json.dump(results, f, indent=1, sort_keys=True)
+
+
+if __name__ == "__main__":
+    main()
@@ -57,6 +57,8 @@ def install(args):
             cmake_cmd += ['-DBOOST_ROOT=' + absexpanduser(args.boost_root)]
         if args.build_type:
             cmake_cmd += ['-DCMAKE_BUILD_TYPE=' + args.build_type]
+        if args.benchmarks:
+            cmake_cmd += ['-DBUILD_BENCHMARKS=ON']
         check_windows_cmake(cmake_cmd)
         rtn = subprocess.check_call(cmake_cmd, cwd=args.build_dir,
                                     shell=(os.name == 'nt'))
@@ -127,6 +129,9 @@ def main():
     build_type = "the CMAKE_BUILD_TYPE"
     parser.add_argument('--build_type', help=build_type)
 
+    benchmarks = "also build the benchmarks (requires google-benchmark)"
+    parser.add_argument('--benchmarks', action='store_true', help=benchmarks)
+
     args = parser.parse_args()
     if args.uninstall:
         uninstall(args)
@@ -0,0 +1,369 @@
+// Allocation tests for the exchange phases of the flexmore archetypes. They
+// replace the global operators new and delete, and on glibc also malloc,
+// calloc and realloc, to count heap allocations and therefore build as their
+// own executable, flexmore_alloc_tests.
+//
+// After warm-up, a time step allocates only what it hands to the exchange
+// and the recorder, so the count of the first step after warm-up is exact
+// for every later step with the same requests, and bounded by a budget
+// linear in the portfolios, bids and constraints. Scratch containers draw
+// from the agents' arenas and allocate nothing.
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <new>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "arena.h"
+#include "cyclus.h"
+#include "env.h"
+#include "exchange_context.h"
+#include "test_context.h"
+
+#include "enrichment.h"
+#include "source.h"
+
+namespace {
+
+long long n_allocs = 0;
+bool counting = false;
+
+}  // namespace
+
+#if defined(__GLIBC__)
+// glibc lets a program replace malloc and exports its own implementation
+// under these names
+extern "C" {
+void* __libc_malloc(std::size_t size);
+void* __libc_calloc(std::size_t n, std::size_t size);
+void* __libc_realloc(void* p, std::size_t size);
+void __libc_free(void* p);
+
+void* malloc(std::size_t size) {
+  if (counting) {
+    ++n_allocs;
+  }
+  return __libc_malloc(size);
+}
+
+void* calloc(std::size_t n, std::size_t size) {
+  if (counting) {
+    ++n_allocs;
+  }
+  return __libc_calloc(n, size);
+}
+
+void* realloc(void* p, std::size_t size) {
+  if (counting) {
+    ++n_allocs;
+  }
+  return __libc_realloc(p, size);
+}
+
+void free(void* p) {
+  __libc_free(p);
+}
+}  // extern "C"
+#endif
+
+namespace {
+
+// allocates for operator new without going through the counted malloc
+void* RawAlloc(std::size_t size) {
+  if (counting) {
+    ++n_allocs;
+  }
+#if defined(__GLIBC__)
+  return __libc_malloc(size > 0 ? size : 1);
+#else
+  return std::malloc(size > 0 ? size : 1);
+#endif
+}
+
+void RawFree(void* p) {
+#if defined(__GLIBC__)
+  __libc_free(p);
+#else
+  std::free(p);
+#endif
+}
+
+}  // namespace
+
+void* operator new(std::size_t size) {
+  void* p = RawAlloc(size);
+  if (p == NULL) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void* operator new[](std::size_t size) {
+  return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return RawAlloc(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return RawAlloc(size);
+}
+
+void operator delete(void* p) noexcept {
+  RawFree(p);
+}
+
+void operator delete[](void* p) noexcept {
+  RawFree(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+  RawFree(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+  RawFree(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+  RawFree(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+  RawFree(p);
+}
+
+namespace flexmore {
+
+typedef std::set<cyclus::BidPortfolio<cyclus::Material>::Ptr> BidPorts;
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// @returns the number of heap allocations made by f
+template <class F>
+long long CountAllocs(F f) {
+  n_allocs = 0;
+  counting = true;
+  f();
+  counting = false;
+  return n_allocs;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+class AllocTest : public ::testing::Test {
+ public:
+  cyclus::TestContext tc;
+  cyclus::ExchangeContext<cyclus::Material> ec;
+  std::vector<cyclus::Material::Ptr> targets;
+
+  virtual void SetUp() {
+    tc.get()->AddRecipe("natu", NatU());
+    tc.get()->AddRecipe("leu", Leu(0.04));
+  }
+
+  static cyclus::Composition::Ptr NatU() {
+    cyclus::CompMap m;
+    m[922350000] = 0.0072;
+    m[922380000] = 0.9928;
+    return cyclus::Composition::CreateFromMass(m);
+  }
+
+  static cyclus::Composition::Ptr Leu(double assay) {
+    cyclus::CompMap m;
+    m[922350000] = assay;
+    m[922380000] = 1 - assay;
+    return cyclus::Composition::CreateFromMass(m);
+  }
+
+  // adds n unit requests for commod, cycling through 4 enrichment levels
+  void AddRequests(int n, std::string commod) {
+    std::vector<cyclus::Composition::Ptr> comps;
+    for (int i = 0; i < 4; i++) {
+      comps.push_back(Leu(0.03 + 0.005 * i));
+    }
+    for (int i = 0; i < n; i++) {
+      targets.push_back(
+          cyclus::Material::CreateUntracked(1, comps[i % comps.size()]));
+      ec.AddRequest(cyclus::Request<cyclus::Material>::Create(
+          targets.back(), tc.trader(), commod));
+    }
+  }
+
+  Enrichment* NewEnrichment(int nfeed, int ntails) {
+    Enrichment* e = new Enrichment(tc.get());
+    e->feed_commod = "natu";
+    e->feed_recipe = "natu";
+    e->product_commod = "enr_u";
+    e->tails_commod = "tails";
+    e->tails_assay = 0.003;
+    e->SetMaxInventorySize(1e299);
+    e->SwuCapacity(1e299);
+    for (int i = 0; i < nfeed; i++) {
+      e->AddMat_(cyclus::Material::CreateUntracked(10, NatU()));
+    }
+    for (int i = 0; i < ntails; i++) {
+      e->tails.Push(cyclus::Material::CreateUntracked(10, Leu(0.003)));
+    }
+    return e;
+  }
+
+  // adds nbids feed bids from 4 compositions to each of nreqs requests
+  void AddFeedBids(Enrichment* e, int nreqs, int nbids,
+                   cyclus::PrefMap<cyclus::Material>::type* prefs) {
+    using cyclus::Bid;
+    using cyclus::Material;
+    using cyclus::Request;
+    std::vector<cyclus::Composition::Ptr> comps;
+    for (int i = 0; i < 4; i++) {
+      comps.push_back(Leu(0.006 + 0.0005 * i));
+    }
+    for (int r = 0; r < nreqs; r++) {
+      Request<Material>* req = Request<Material>::Create(
+          Material::CreateUntracked(1, NatU()), e, "natu");
+      for (int b = 0; b < nbids; b++) {
+        Material::Ptr offer =
+            Material::CreateUntracked(1, comps[(r + b) % comps.size()]);
+        (*prefs)[req][Bid<Material>::Create(req, offer, tc.trader())] = 1;
+      }
+    }
+  }
+
+  Source* NewSource(std::string recipe) {
+    Source* s = new Source(tc.get());
+    s->outcommod = "commod";
+    s->outrecipe = recipe;
+    s->throughput = std::vector<double>(1, 1e299);
+    s->Tick();
+    return s;
+  }
+
+  // upper bound on the allocations of a GetMatlBids that returned ports:
+  // each portfolio, each bid with its set node and a fresh offer, and each
+  // constraint with its converter, plus the names and records of the step
+  static long long AllocBudget(const BidPorts& ports) {
+    const long long kFixed = 32;
+    const long long kPerPort = 8;
+    const long long kPerBid = 4;
+    const long long kPerConstraint = 4;
+    long long budget = kFixed;
+    BidPorts::const_iterator it;
+    for (it = ports.begin(); it != ports.end(); ++it) {
+      budget += kPerPort + kPerBid * (*it)->bids().size() +
+                kPerConstraint * (*it)->constraints().size();
+    }
+    return budget;
+  }
+
+  // runs GetMatlBids of agent once to warm up and then in three time steps,
+  // each of which must return nports portfolios holding nbids bids in all,
+  // stay within AllocBudget, allocate as much as the first and leave the
+  // capacity of the agent's arena unchanged
+  template <class T>
+  void CheckSteadyBids(T* agent, int nports, int nbids) {
+    agent->Tick();
+    agent->GetMatlBids(ec.commod_requests);
+
+    long long steady = 0;
+    std::size_t capacity = 0;
+    for (int step = 0; step < 3; step++) {
+      agent->Tick();
+      BidPorts ports;
+      long long used = CountAllocs([&]() {
+        ports = agent->GetMatlBids(ec.commod_requests);
+      });
+      ASSERT_EQ(nports, ports.size());
+      int bids = 0;
+      BidPorts::const_iterator it;
+      for (it = ports.begin(); it != ports.end(); ++it) {
+        bids += (*it)->bids().size();
+      }
+      EXPECT_EQ(nbids, bids);
+      EXPECT_LE(used, AllocBudget(ports));
+      if (step == 0) {
+        steady = used;
+        capacity = agent->scratch_.capacity();
+      }
+      EXPECT_EQ(steady, used);
+      EXPECT_EQ(capacity, agent->scratch_.capacity());
+    }
+  }
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(AllocTest, EnrichmentBids) {
+  // one product bid per product request, one tails bid per tails lot and
+  // tails request; the warm-up builds the tails snapshot, offer
+  // compositions, converters and names
+  Enrichment* e = NewEnrichment(20, 5);
+  AddRequests(50, "enr_u");
+  AddRequests(3, "tails");
+  CheckSteadyBids(e, 2, 50 + 3 * 5);
+  delete e;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(AllocTest, EnrichmentPrefs) {
+  // scratch containers come from the arena, which is rewound every Tick
+  Enrichment* e = NewEnrichment(1, 0);
+  cyclus::PrefMap<cyclus::Material>::type prefs;
+  AddFeedBids(e, 20, 30, &prefs);
+
+  e->Tick();
+  e->AdjustMatlPrefs(prefs);
+  std::size_t capacity = e->scratch_.capacity();
+  e->Tick();
+
+  long long used = CountAllocs([&]() { e->AdjustMatlPrefs(prefs); });
+  EXPECT_EQ(0, used);
+  EXPECT_EQ(capacity, e->scratch_.capacity());
+  delete e;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(AllocTest, ArenaReuse) {
+  MonotonicArena arena(1024);
+  ArenaAllocator<int> alloc(&arena);
+  std::size_t capacity = 0;
+  for (int step = 0; step < 3; step++) {
+    arena.Reset();
+    long long used = CountAllocs([&]() {
+      std::vector<int, ArenaAllocator<int> > v(alloc);
+      for (int i = 0; i < 1000; i++) {
+        v.push_back(i);
+      }
+    });
+    if (step == 0) {
+      capacity = arena.capacity();
+    } else {
+      EXPECT_EQ(0, used);
+    }
+    EXPECT_EQ(capacity, arena.capacity());
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(AllocTest, SourceBids) {
+  Source* s = NewSource("leu");
+  AddRequests(50, "commod");
+  CheckSteadyBids(s, 1, 50);
+  delete s;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(AllocTest, SourceBidsWithoutRecipe) {
+  Source* s = NewSource("");
+  AddRequests(50, "commod");
+  CheckSteadyBids(s, 1, 50);
+  delete s;
+}
+
+}  // namespace flexmore
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+int main(int argc, char* argv[]) {
+  cyclus::Env::SetNucDataPath();
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
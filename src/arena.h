@@ -0,0 +1,131 @@
+#ifndef FLEXMORE_SRC_ARENA_H_
+#define FLEXMORE_SRC_ARENA_H_
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace flexmore {
+
+/// @class MonotonicArena
+///
+/// @brief The MonotonicArena hands out memory from large blocks by bumping
+/// an offset and never frees individual allocations. Reset rewinds the
+/// arena to its first block while keeping all blocks, so a container
+/// pattern that repeats every time step settles into reusing the same
+/// memory without touching the heap. Memory handed out before a Reset must
+/// not be used after it.
+class MonotonicArena {
+ public:
+  /// @param block_size the size of the blocks requested from the heap, in
+  /// bytes. Larger allocations get a block of their own size.
+  explicit MonotonicArena(std::size_t block_size = 64 * 1024)
+      : block_size_(block_size), current_(0), offset_(0), used_(0) {}
+
+  ~MonotonicArena() {
+    for (int i = 0; i < blocks_.size(); ++i) {
+      ::operator delete(blocks_[i].data);
+    }
+  }
+
+  /// @returns size bytes aligned to align, which must be a power of two
+  void* Allocate(std::size_t size, std::size_t align) {
+    while (current_ < blocks_.size()) {
+      Block& b = blocks_[current_];
+      std::size_t start = (offset_ + align - 1) & ~(align - 1);
+      if (start + size <= b.size) {
+        offset_ = start + size;
+        used_ += size;
+        return b.data + start;
+      }
+      ++current_;
+      offset_ = 0;
+    }
+
+    Block b;
+    b.size = size + align > block_size_ ? size + align : block_size_;
+    // blocks come from the global operator new, like any other heap memory
+    // of the archetypes, so allocation hooks see them
+    b.data = static_cast<char*>(::operator new(b.size));
+    blocks_.push_back(b);
+    current_ = blocks_.size() - 1;
+    offset_ = 0;
+    return Allocate(size, align);
+  }
+
+  /// @brief makes all blocks available again, invalidating everything
+  /// allocated so far
+  void Reset() {
+    current_ = 0;
+    offset_ = 0;
+    used_ = 0;
+  }
+
+  /// @returns the number of bytes handed out since the last Reset
+  std::size_t used() const { return used_; }
+
+  /// @returns the number of bytes held in blocks
+  std::size_t capacity() const {
+    std::size_t total = 0;
+    for (int i = 0; i < blocks_.size(); ++i) {
+      total += blocks_[i].size;
+    }
+    return total;
+  }
+
+ private:
+  struct Block {
+    char* data;
+    std::size_t size;
+  };
+
+  MonotonicArena(const MonotonicArena&);
+  MonotonicArena& operator=(const MonotonicArena&);
+
+  std::size_t block_size_;
+  std::vector<Block> blocks_;
+  std::size_t current_;
+  std::size_t offset_;
+  std::size_t used_;
+};
+
+/// @class ArenaAllocator
+///
+/// @brief The ArenaAllocator is a standard allocator drawing from a
+/// MonotonicArena, for scratch containers that live within one time step.
+/// Deallocation is a no-op; memory is reclaimed by MonotonicArena::Reset.
+template <class T>
+class ArenaAllocator {
+ public:
+  typedef T value_type;
+
+  explicit ArenaAllocator(MonotonicArena* arena) : arena_(arena) {}
+
+  template <class U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena()) {}
+
+  T* allocate(std::size_t n) {
+    return static_cast<T*>(arena_->Allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T* p, std::size_t n) {}
+
+  MonotonicArena* arena() const { return arena_; }
+
+ private:
+  MonotonicArena* arena_;
+};
+
+template <class T, class U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() == b.arena();
+}
+
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() != b.arena();
+}
+
+}  // namespace flexmore
+
+#endif  // FLEXMORE_SRC_ARENA_H_
@@ -0,0 +1,75 @@
+#ifndef FLEXMORE_SRC_COMPOSITION_INTERNER_H_
+#define FLEXMORE_SRC_COMPOSITION_INTERNER_H_
+
+#include <cmath>
+#include <list>
+#include <map>
+#include <utility>
+
+#include "cyclus.h"
+
+namespace flexmore {
+
+/// @class CompositionInterner
+///
+/// @brief The CompositionInterner hands out shared uranium compositions,
+/// keyed by their quantized U-235 and U-238 atom fractions, so that offers
+/// for the same enrichment level share a single Composition::Ptr across
+/// requests and time steps. It holds at most max_size compositions and
+/// evicts the least recently used one when it is full.
+class CompositionInterner {
+ public:
+  /// @param max_size the maximum number of interned compositions
+  /// @param quantum the resolution at which atom fractions are compared
+  explicit CompositionInterner(int max_size = 1000, double quantum = 1e-12)
+      : max_size_(max_size),
+        quantum_(quantum),
+        hits_(0),
+        misses_(0),
+        evictions_(0) {}
+
+  /// @returns a composition of U-235 and U-238 with the given atom
+  /// fractions, reusing an interned composition if there is one
+  cyclus::Composition::Ptr Get(double u235, double u238) {
+    Key key(std::llround(u235 / quantum_), std::llround(u238 / quantum_));
+    std::map<Key, LruList::iterator>::iterator it = index_.find(key);
+    if (it != index_.end()) {
+      ++hits_;
+      lru_.splice(lru_.begin(), lru_, it->second);
+      return it->second->second;
+    }
+
+    ++misses_;
+    cyclus::CompMap comp;
+    comp[922350000] = u235;
+    comp[922380000] = u238;
+    cyclus::Composition::Ptr c = cyclus::Composition::CreateFromAtom(comp);
+    lru_.push_front(std::make_pair(key, c));
+    index_[key] = lru_.begin();
+    if (lru_.size() > max_size_) {
+      index_.erase(lru_.back().first);
+      lru_.pop_back();
+      ++evictions_;
+    }
+    return c;
+  }
+
+  inline long hits() const { return hits_; }
+  inline long misses() const { return misses_; }
+  inline long evictions() const { return evictions_; }
+  inline int size() const { return index_.size(); }
+
+ private:
+  typedef std::pair<long long, long long> Key;
+  typedef std::list<std::pair<Key, cyclus::Composition::Ptr> > LruList;
+
+  LruList lru_;
+  std::map<Key, LruList::iterator> index_;
+  int max_size_;
+  double quantum_;
+  long hits_, misses_, evictions_;
+};
+
+}  // namespace flexmore
+
+#endif  // FLEXMORE_SRC_COMPOSITION_INTERNER_H_
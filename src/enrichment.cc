@@ -3,14 +3,30 @@
 
 #include <algorithm>
 #include <cmath>
+#include <functional>
 #include <limits>
+#include <map>
+#include <set>
 #include <sstream>
+#include <utility>
 #include <vector>
 
 #include <boost/lexical_cast.hpp>
 
 namespace flexmore {
 
+// scratch containers drawing from an agent's MonotonicArena
+typedef std::map<int, double, std::less<int>,
+                 ArenaAllocator<std::pair<const int, double> > > FracMap;
+typedef std::vector<int, ArenaAllocator<int> > IdVec;
+
+// number of product requests or trades from which SWU and feed are computed
+// with an EnrichmentBatch instead of one material at a time
+const int kMinBatch = 16;
+
+// relative change of the feed assay up to which batch results are reused
+const double kBatchFeedTol = 1e-12;
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 Enrichment::Enrichment(cyclus::Context* ctx)
     : cyclus::Facility(ctx),
@@ -23,9 +39,32 @@ Enrichment::Enrichment(cyclus::Context* ctx)
       product_commod(""),
       tails_commod(""),
       order_prefs(true),
+      aggregate_tails_bids(false),
+      tails_bin_width(1e-4),
+      compact_tails(false),
+      tails_compaction_threshold(0),
+      enrichment_records("trade"),
+      record_timings(false),
+      record_exchange_footprint(false),
+      reuse_bids(false),
+      intra_timestep_swu_(0),
+      intra_timestep_feed_(0),
+      intra_timestep_enrichments_(0),
       latitude(0.0),
       longitude(0.0),
-      coordinates(latitude, longitude) {}
+      coordinates(latitude, longitude),
+      feed_u235_(0),
+      feed_u238_(0),
+      feed_total_(0),
+      feed_tally_valid_(false),
+      conversion_cache_(new ConversionCache()),
+      tails_offers_valid_(false),
+      tails_offers_binned_(false),
+      tails_compaction_lots_(0),
+      converter_feed_assay_(-1),
+      converter_tails_assay_(-1),
+      reuse_tails_assay_(-1),
+      reuse_max_enrich_(-1) {}
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 Enrichment::~Enrichment() {}
@@ -64,18 +103,40 @@ void Enrichment::EnterNotify() {
   
   intra_timestep_swu_ = 0;
   intra_timestep_feed_ = 0;
+  intra_timestep_enrichments_ = 0;
 
   int ltime = lifetime() != -1 ? 
       lifetime() : context()->sim_info().duration - enter_time();
   
-  if (swu_vector.size() == 1) {
-    swu_vector = std::vector<double>(ltime, swu_vector[0]);
-  }
-
   std::stringstream ss;
-  if (swu_vector.size() != ltime) {
+  if (enrichment_records != "trade" && enrichment_records != "timestep" &&
+      enrichment_records != "none") {
+    ss << "Prototype '" << prototype() << "' has invalid "
+       << "enrichment_records '" << enrichment_records << "', expected "
+       << "'trade', 'timestep' or 'none'\n";
+  }
+  if (tails_bin_width <= 0) {
+    ss << "Prototype '" << prototype() << "' has non-positive "
+       << "tails_bin_width " << tails_bin_width << "\n";
+  }
+  // a single value is used for all time steps
+  if (!swu_runs.empty()) {
+    int total = 0;
+    for (int i = 0; i < swu_runs.size(); i++) {
+      if (swu_runs[i] <= 0) {
+        ss << "Prototype '" << prototype() << "' has non-positive value "
+           << swu_runs[i] << " in position " << i << " of swu_runs\n";
+      }
+      total += swu_runs[i];
+    }
+    if (swu_runs.size() != swu_vector.size() || total != ltime) {
+      ss << "Prototype '" << prototype() << "' has " << swu_runs.size()
+         << " swu_runs summing to " << total << ", expected "
+         << swu_vector.size() << " summing to " << ltime << "\n";
+    }
+  } else if (swu_vector.size() != 1 && swu_vector.size() != ltime) {
     ss << "Prototype '" << prototype() << "' has "
-       << swu_vector.size() << " swu_vector vals, expected "
+       << swu_vector.size() << " swu_vector vals, expected 1 or "
        << ltime << "\n";
   }
   for (int i = 0; i < swu_vector.size(); i++) {
@@ -89,26 +150,63 @@ void Enrichment::EnterNotify() {
   if (ss.str().size() > 0) {
     throw cyclus::ValueError(ss.str());
   }
+  swu_schedule_ = Schedule(swu_vector, swu_runs);
+  if (swu_vector.size() > 1) {
+    swu_vector = swu_schedule_.values();
+    swu_runs = swu_schedule_.lengths();
+  }
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void Enrichment::Tick() {
+  PhaseTimer timer(this, "Tick", record_timings);
+  scratch_.Reset();
   int t = context()->time() - enter_time();
-  
-  swu_capacity = swu_vector[t];
-  current_swu_capacity = swu_vector[t];
+
+  if (swu_schedule_.empty()) {
+    swu_schedule_ = Schedule(swu_vector, swu_runs);
+  }
+  swu_capacity = swu_schedule_.value(t);
+  current_swu_capacity = swu_capacity;
+  intra_timestep_enrichments_ = 0;
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void Enrichment::Tock() {
   using cyclus::toolkit::RecordTimeSeries;
+  // completes the trace file in the last time step, including this Tock
+  TraceFlush flush(this);
+  PhaseTimer timer(this, "Tock", record_timings);
   LOG(cyclus::LEV_INFO4, "EnrFac") << prototype() << " used "
                                    << intra_timestep_swu_ << " SWU";
   RecordTimeSeries<cyclus::toolkit::ENRICH_SWU>(this, intra_timestep_swu_);
   LOG(cyclus::LEV_INFO4, "EnrFac") << prototype() << " used "
                                    << intra_timestep_feed_ << " feed";
   RecordTimeSeries<cyclus::toolkit::ENRICH_FEED>(this, intra_timestep_feed_);
-  RecordTimeSeries<double>("demand"+feed_commod, this, intra_timestep_feed_);
+  if (demand_feed_ts_.empty()) {
+    demand_feed_ts_ = "demand" + feed_commod;
+  }
+  RecordTimeSeries<double>(demand_feed_ts_, this, intra_timestep_feed_);
+  if (enrichment_records == "timestep" && intra_timestep_enrichments_ > 0) {
+    RecordEnrichment_(intra_timestep_feed_, intra_timestep_swu_);
+  }
+  LOG(cyclus::LEV_INFO4, "EnrFac") << prototype() << " converter cache: "
+                                   << conversion_cache_->hits() << " hits, "
+                                   << conversion_cache_->misses()
+                                   << " misses";
+  LOG(cyclus::LEV_INFO4, "EnrFac") << prototype() << " offer compositions: "
+                                   << offer_comps_.hits() << " hits, "
+                                   << offer_comps_.misses() << " misses, "
+                                   << offer_comps_.evictions()
+                                   << " evictions";
+  if (record_exchange_footprint) {
+    footprint_.Record(this);
+  }
+  footprint_.Reset();
+
+  if (compact_tails) {
+    CompactTails_();
+  }
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -117,6 +215,7 @@ Enrichment::GetMatlRequests() {
   using cyclus::Material;
   using cyclus::RequestPortfolio;
   using cyclus::Request;
+  PhaseTimer timer(this, "GetMatlRequests", record_timings);
 
   std::set<RequestPortfolio<Material>::Ptr> ports;
   RequestPortfolio<Material>::Ptr port(new RequestPortfolio<Material>());
@@ -126,23 +225,36 @@ Enrichment::GetMatlRequests() {
   if (amt > cyclus::eps_rsrc()) {
     port->AddRequest(mat, this, feed_commod);
     ports.insert(port);
+    footprint_.requests_made++;
   }
 
   return ports;
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-bool SortBids(cyclus::Bid<cyclus::Material>* i,
-              cyclus::Bid<cyclus::Material>* j) {
-  cyclus::Material::Ptr mat_i = i->offer();
-  cyclus::Material::Ptr mat_j = j->offer();
+// Returns the U-235 mass fraction of a material. Fractions are memoized in
+// fracs by composition id since many offers share the same composition.
+double U235MassFrac(cyclus::Material::Ptr mat, FracMap* fracs) {
+  cyclus::Composition::Ptr comp = mat->comp();
+  FracMap::iterator it = fracs->find(comp->id());
+  if (it != fracs->end()) {
+    return it->second;
+  }
 
-  cyclus::toolkit::MatQuery mq_i(mat_i);
-  cyclus::toolkit::MatQuery mq_j(mat_j);
+  double frac = UraniumMassView(comp).u235();
+  (*fracs)[comp->id()] = frac;
+  return frac;
+}
 
-  return ((mq_i.mass(922350000) / mq_i.qty()) <=
-          (mq_j.mass(922350000) / mq_j.qty()));
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Orders (U-235 mass fraction, bid position) keys by U-235 content, ties
+// keep their bid order. Since positions are unique this makes std::sort
+// stable without the temporary buffer std::stable_sort allocates.
+bool SortBids(const std::pair<double, int>& i,
+              const std::pair<double, int>& j) {
+  return i.first < j.first || (i.first == j.first && i.second < j.second);
 }
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 // Sort offers of input material to have higher preference for more
 //  U-235 content
@@ -151,49 +263,60 @@ void Enrichment::AdjustMatlPrefs(
   using cyclus::Bid;
   using cyclus::Material;
   using cyclus::Request;
+  PhaseTimer timer(this, "AdjustMatlPrefs", record_timings);
 
   if (order_prefs == false) {
     return;
   }
 
+  typedef std::map<Bid<Material>*, double>::iterator PrefIt;
+  typedef std::pair<double, int> Key;
+
+  // U-235 fractions are computed once per offered composition, and the
+  // bid ordering is reused by consecutive requests that are offered the
+  // same compositions in the same order
+  ArenaAllocator<char> alloc(&scratch_);
+  FracMap u235_fracs(std::less<int>(), alloc);
+  IdVec comp_ids(alloc);
+  IdVec prev_comp_ids(alloc);
+  std::vector<PrefIt, ArenaAllocator<PrefIt> > pref_its(alloc);
+  std::vector<Key, ArenaAllocator<Key> > order(alloc);
+
   cyclus::PrefMap<cyclus::Material>::type::iterator reqit;
 
   // Loop over all requests
   for (reqit = prefs.begin(); reqit != prefs.end(); ++reqit) {
-    std::vector<Bid<Material>*> bids_vector;
-    std::map<Bid<Material>*, double>::iterator mit;
+    comp_ids.clear();
+    pref_its.clear();
+    PrefIt mit;
     for (mit = reqit->second.begin(); mit != reqit->second.end(); ++mit) {
-      Bid<Material>* bid = mit->first;
-      bids_vector.push_back(bid);
+      pref_its.push_back(mit);
+      comp_ids.push_back(mit->first->offer()->comp()->id());
     }
-    std::sort(bids_vector.begin(), bids_vector.end(), SortBids);
-
-    // Assign preferences to the sorted vector
-    double n_bids = bids_vector.size();
-    bool u235_mass = 0;
-
-    for (int bidit = 0; bidit < bids_vector.size(); bidit++) {
-      int new_pref = bidit + 1;
 
-      // For any bids with U-235 qty=0, set pref to zero.
-      if (!u235_mass) {
-        cyclus::Material::Ptr mat = bids_vector[bidit]->offer();
-        cyclus::toolkit::MatQuery mq(mat);
-        if (mq.mass(922350000) == 0) {
-          new_pref = -1;
-        } else {
-          u235_mass = true;
-        }
+    if (comp_ids != prev_comp_ids) {
+      order.clear();
+      for (int i = 0; i < pref_its.size(); i++) {
+        double frac = U235MassFrac(pref_its[i]->first->offer(), &u235_fracs);
+        order.push_back(std::make_pair(frac, i));
       }
-      (reqit->second)[bids_vector[bidit]] = new_pref;
-    }  // each bid
-  }    // each Material Request
+      std::sort(order.begin(), order.end(), SortBids);
+      prev_comp_ids.swap(comp_ids);
+    }
+
+    // Assign preferences in sorted order, bids without U-235 are rejected
+    for (int rank = 0; rank < order.size(); rank++) {
+      pref_its[order[rank].second]->second =
+          order[rank].first > 0 ? rank + 1 : -1;
+    }
+  }  // each Material Request
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void Enrichment::AcceptMatlTrades(
     const std::vector<std::pair<cyclus::Trade<cyclus::Material>,
                                 cyclus::Material::Ptr> >& responses) {
+  PhaseTimer timer(this, "AcceptMatlTrades", record_timings);
   // see
   // http://stackoverflow.com/questions/5181183/boostshared-ptr-and-inheritance
   std::vector<std::pair<cyclus::Trade<cyclus::Material>,
@@ -201,6 +324,7 @@ void Enrichment::AcceptMatlTrades(
   for (it = responses.begin(); it != responses.end(); ++it) {
     AddMat_(it->second);
   }
+  footprint_.trades_accepted += responses.size();
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -214,22 +338,30 @@ std::set<cyclus::BidPortfolio<cyclus::Material>::Ptr> Enrichment::GetMatlBids(
   using cyclus::Request;
   using cyclus::toolkit::MatVec;
   using cyclus::toolkit::RecordTimeSeries;
+  PhaseTimer timer(this, "GetMatlBids", record_timings);
 
   std::set<BidPortfolio<Material>::Ptr> ports;
 
-  RecordTimeSeries<double>("supply" + tails_commod, this, tails.quantity());
-  RecordTimeSeries<double>("supply" + product_commod, this, inventory.quantity());
+  if (supply_tails_ts_.empty()) {
+    supply_tails_ts_ = "supply" + tails_commod;
+    supply_product_ts_ = "supply" + product_commod;
+  }
+  RecordTimeSeries<double>(supply_tails_ts_, this, tails.quantity());
+  RecordTimeSeries<double>(supply_product_ts_, this, inventory.quantity());
   if ((out_requests.count(tails_commod) > 0) && (tails.quantity() > 0)) {
+    TraceSpan span(this, "TailsBids");
     BidPortfolio<Material>::Ptr tails_port(new BidPortfolio<Material>());
 
+    // a single snapshot of the tails buffer serves all requests
+    const MatVec& mats = TailsOffers_();
+
     std::vector<Request<Material>*>& tails_requests =
         out_requests[tails_commod];
+    footprint_.requests_seen += tails_requests.size();
     std::vector<Request<Material>*>::iterator it;
     for (it = tails_requests.begin(); it != tails_requests.end(); ++it) {
-      // offer bids for all tails material, keeping discrete quantities
-      // to preserve possible variation in composition
-      MatVec mats = tails.PopN(tails.count());
-      tails.Push(mats);
+      // offer bids for all tails material, keeping discrete quantities (or
+      // assay bins) to preserve possible variation in composition
       for (int k = 0; k < mats.size(); k++) {
         Material::Ptr m = mats[k];
         Request<Material>* req = *it;
@@ -244,6 +376,8 @@ std::set<cyclus::BidPortfolio<cyclus::Material>::Ptr> Enrichment::GetMatlBids(
                                      << " adding tails capacity constraint of "
                                      << tails.capacity();
     ports.insert(tails_port);
+    footprint_.bids += tails_port->bids().size();
+    footprint_.constraints += tails_port->constraints().size();
   }
 
   if ((out_requests.count(product_commod) > 0) && (inventory.quantity() > 0)) {
@@ -251,23 +385,67 @@ std::set<cyclus::BidPortfolio<cyclus::Material>::Ptr> Enrichment::GetMatlBids(
 
     std::vector<Request<Material>*>& commod_requests =
         out_requests[product_commod];
-    std::vector<Request<Material>*>::iterator it;
-    for (it = commod_requests.begin(); it != commod_requests.end(); ++it) {
-      Request<Material>* req = *it;
-      Material::Ptr mat = req->target();
-      double request_enrich = cyclus::toolkit::UraniumAssayMass(mat);
-      if (ValidReq(req->target()) &&
-          ((request_enrich < max_enrich) ||
-           (cyclus::AlmostEq(request_enrich, max_enrich)))) {
-        Material::Ptr offer = Offer_(req->target());
+    int nreqs = commod_requests.size();
+    footprint_.requests_seen += nreqs;
+    if (reuse_bids && (reuse_tails_assay_ != tails_assay ||
+                       reuse_max_enrich_ != max_enrich)) {
+      reused_offers_.clear();
+      reuse_tails_assay_ = tails_assay;
+      reuse_max_enrich_ = max_enrich;
+    }
+    int nreused = 0;
+    for (int i = 0; i < nreqs; ++i) {
+      Request<Material>* req = commod_requests[i];
+      Material::Ptr offer;
+      if (reuse_bids) {
+        bool reused;
+        offer = ReuseOffer_(req->target(), &reused);
+        nreused += reused;
+      } else {
+        offer = ValidOffer_(req->target());
+      }
+      if (offer) {
         commod_port->AddBid(req, offer, this);
+        if (nreqs >= kMinBatch) {
+          batch_offers_.push_back(offer);
+        }
       }
     }
+    if (reuse_bids) {
+      int now = context()->time();
+      ReusedOfferMap::iterator it = reused_offers_.begin();
+      while (it != reused_offers_.end()) {
+        if (it->second.time != now) {
+          reused_offers_.erase(it++);
+        } else {
+          ++it;
+        }
+      }
+      context()
+          ->NewDatum("BidReuse")
+          ->AddVal("AgentId", id())
+          ->AddVal("Time", context()->time())
+          ->AddVal("Requests", nreqs)
+          ->AddVal("Reused", nreused)
+          ->Record();
+    }
 
-    Converter<Material>::Ptr sc(new SWUConverter(FeedAssay(), tails_assay));
-    Converter<Material>::Ptr nc(new NatUConverter(FeedAssay(), tails_assay));
-    CapacityConstraint<Material> swu(swu_capacity, sc);
-    CapacityConstraint<Material> natu(inventory.quantity(), nc);
+    double feed_assay = FeedAssay();
+    if (!batch_offers_.empty()) {
+      PrimeConversions_(batch_offers_, feed_assay);
+      batch_offers_.clear();
+    }
+    if (!swu_converter_ || feed_assay != converter_feed_assay_ ||
+        tails_assay != converter_tails_assay_) {
+      swu_converter_.reset(
+          new SWUConverter(feed_assay, tails_assay, conversion_cache_, this));
+      natu_converter_.reset(
+          new NatUConverter(feed_assay, tails_assay, conversion_cache_, this));
+      converter_feed_assay_ = feed_assay;
+      converter_tails_assay_ = tails_assay;
+    }
+    CapacityConstraint<Material> swu(swu_capacity, swu_converter_);
+    CapacityConstraint<Material> natu(inventory.quantity(), natu_converter_);
     commod_port->AddConstraint(swu);
     commod_port->AddConstraint(natu);
 
@@ -276,16 +454,16 @@ std::set<cyclus::BidPortfolio<cyclus::Material>::Ptr> Enrichment::GetMatlBids(
     LOG(cyclus::LEV_INFO5, "EnrFac")
         << prototype() << " adding a natu constraint of " << natu.capacity();
     ports.insert(commod_port);
+    footprint_.bids += commod_port->bids().size();
+    footprint_.constraints += commod_port->constraints().size();
   }
   return ports;
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 bool Enrichment::ValidReq(const cyclus::Material::Ptr mat) {
-  cyclus::toolkit::MatQuery q(mat);
-  double u235 = q.atom_frac(922350000);
-  double u238 = q.atom_frac(922380000);
-  return (u238 > 0 && u235 / (u235 + u238) > tails_assay);
+  UraniumAtomView u(mat);
+  return (u.u238() > 0 && u.assay() > tails_assay);
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -295,11 +473,46 @@ void Enrichment::GetMatlTrades(
                           cyclus::Material::Ptr> >& responses) {
   using cyclus::Material;
   using cyclus::Trade;
+  PhaseTimer timer(this, "GetMatlTrades", record_timings);
 
   intra_timestep_swu_ = 0;
   intra_timestep_feed_ = 0;
+  footprint_.trades_received += trades.size();
 
+  // with many product trades, compute all enrichments at the current feed
+  // assay at once
   std::vector<Trade<Material>>::const_iterator it;
+  bool batchable = true;
+  batch_.Clear();
+  for (it = trades.begin(); it != trades.end(); ++it) {
+    if (it->bid->request()->commodity() != tails_commod) {
+      double assay = UraniumMassView(it->bid->offer()).assay();
+      batchable = batchable && assay > 0 && assay < 1;
+      batch_.Add(it->amt, assay);
+    }
+  }
+  const EnrichmentBatch* batch = NULL;
+  if (batchable && batch_.size() >= kMinBatch) {
+    batch_.Compute(FeedAssay(), tails_assay);
+    batch = &batch_;
+  }
+
+  // tails lots are taken out of the buffer before any product trade pushes
+  // this time step's tails, so that each trade is filled from the lots
+  // behind its offer
+  cyclus::toolkit::MatVec lots;
+  TailsLotIndex lot_index;
+  bool lots_taken = false;
+  for (it = trades.begin(); it != trades.end() && !lots_taken; ++it) {
+    lots_taken = it->bid->request()->commodity() == tails_commod;
+  }
+  if (lots_taken) {
+    lots = tails.PopN(tails.count());
+    IndexTailsLots_(lots, &lot_index);
+  }
+  static const std::vector<int> kNoLots;
+
+  int k = 0;
   for (it = trades.begin(); it != trades.end(); ++it) {
     double qty = it->amt;
     std::string commod_type = it->bid->request()->commodity();
@@ -310,21 +523,38 @@ void Enrichment::GetMatlTrades(
       LOG(cyclus::LEV_INFO5, "EnrFac")
           << prototype() << " just received an order"
           << " for " << it->amt << " of " << tails_commod;
-      double pop_qty = std::min(qty, tails.quantity());
-      response = tails.Pop(pop_qty, cyclus::eps_rsrc());
+      TailsLotIndex::const_iterator own =
+          lot_index.find(it->bid->offer().get());
+      response = TakeTails_(
+          qty, own == lot_index.end() ? kNoLots : own->second, &lots);
+      if (!response || response->quantity() < qty - cyclus::eps_rsrc()) {
+        std::stringstream ss;
+        ss << "is being asked to provide more than its current inventory.";
+        throw cyclus::ValueError(Agent::InformErrorMsg(ss.str()));
+      }
     } else {
       LOG(cyclus::LEV_INFO5, "EnrFac")
           << prototype() << " just received an order"
           << " for " << it->amt << " of " << product_commod;
-      response = Enrich_(it->bid->offer(), qty);
+      response = Enrich_(it->bid->offer(), qty, batch, k++);
     }
     responses.push_back(std::make_pair(*it, response));
+    footprint_.trades_answered++;
   }
 
-  if (cyclus::IsNegative(tails.quantity())) {
-    std::stringstream ss;
-    ss << "is being asked to provide more than its current inventory.";
-    throw cyclus::ValueError(Agent::InformErrorMsg(ss.str()));
+  // return the remaining lots ahead of the tails of this time step's
+  // enrichments
+  if (lots_taken) {
+    cyclus::toolkit::MatVec fresh = tails.PopN(tails.count());
+    for (int i = 0; i < lots.size(); i++) {
+      if (lots[i] && lots[i]->quantity() > cyclus::eps_rsrc()) {
+        tails.Push(lots[i]);
+      }
+    }
+    tails_compaction_lots_ =
+        std::min<int>(tails_compaction_lots_, tails.count());
+    tails.Push(fresh);
+    tails_offers_valid_ = false;
   }
   if (cyclus::IsNegative(current_swu_capacity)) {
     throw cyclus::ValueError("EnrFac " + prototype() +
@@ -369,6 +599,9 @@ void Enrichment::AddMat_(cyclus::Material::Ptr mat) {
     e.msg(Agent::InformErrorMsg(e.msg()));
     throw e;
   }
+  if (feed_tally_valid_) {
+    TallyFeed_(mat, 1);
+  }
 
   LOG(cyclus::LEV_INFO5, "EnrFac")
       << prototype() << " added " << mat->quantity() << " of " << feed_commod
@@ -385,40 +618,77 @@ cyclus::Material::Ptr Enrichment::Request_() {
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 cyclus::Material::Ptr Enrichment::Offer_(cyclus::Material::Ptr mat) {
-  cyclus::toolkit::MatQuery q(mat);
-  cyclus::CompMap comp;
-  comp[922350000] = q.atom_frac(922350000);
-  comp[922380000] = q.atom_frac(922380000);
+  UraniumAtomView u(mat);
   return cyclus::Material::CreateUntracked(
-      mat->quantity(), cyclus::Composition::CreateFromAtom(comp));
+      mat->quantity(), offer_comps_.Get(u.u235(), u.u238()));
 }
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+cyclus::Material::Ptr Enrichment::ValidOffer_(cyclus::Material::Ptr req) {
+  double request_enrich = UraniumMassView(req).assay();
+  if (ValidReq(req) &&
+      ((request_enrich < max_enrich) ||
+       (cyclus::AlmostEq(request_enrich, max_enrich)))) {
+    return Offer_(req);
+  }
+  return cyclus::Material::Ptr();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+cyclus::Material::Ptr Enrichment::ReuseOffer_(cyclus::Material::Ptr req,
+                                              bool* reused) {
+  // offers depend on the requested composition and quantity only, so
+  // requests that agree on both can share an earlier result
+  double qty = req->quantity();
+  ReusedOffer& prev =
+      reused_offers_[std::make_pair(req->comp()->id(), qty)];
+  int now = context()->time();
+  // repeats within a time step share the entry but are not counted as
+  // reused across time steps
+  *reused = prev.time >= 0 && prev.time < now;
+  if (prev.time < 0) {
+    cyclus::Material::Ptr offer = ValidOffer_(req);
+    if (offer) {
+      prev.comp = offer->comp();
+    }
+  }
+  prev.time = now;
+  if (!prev.comp) {
+    return cyclus::Material::Ptr();
+  }
+  return cyclus::Material::CreateUntracked(qty, prev.comp);
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 cyclus::Material::Ptr Enrichment::Enrich_(cyclus::Material::Ptr mat,
-                                          double qty) {
+                                          double qty,
+                                          const EnrichmentBatch* batch,
+                                          int k) {
   using cyclus::Material;
   using cyclus::ResCast;
   using cyclus::toolkit::Assays;
-  using cyclus::toolkit::UraniumAssayMass;
   using cyclus::toolkit::SwuRequired;
   using cyclus::toolkit::FeedQty;
   using cyclus::toolkit::TailsQty;
+  TraceSpan span(this, "Enrich_");
 
-  // get enrichment parameters
-  Assays assays(FeedAssay(), UraniumAssayMass(mat), tails_assay);
-  double swu_req = SwuRequired(qty, assays);
-  double natu_req = FeedQty(qty, assays);
+  // get enrichment parameters, from the batch if the feed assay has not
+  // moved since it was computed
+  Assays assays(FeedAssay(), UraniumMassView(mat).assay(), tails_assay);
+  double swu_req;
+  double natu_req;
+  if (batch != NULL && batch->tails_assay() == tails_assay &&
+      std::abs(assays.Feed() - batch->feed_assay()) <=
+          kBatchFeedTol * assays.Feed()) {
+    swu_req = batch->swu[k];
+    natu_req = batch->feed[k];
+  } else {
+    swu_req = SwuRequired(qty, assays);
+    natu_req = FeedQty(qty, assays);
+  }
 
   // Determine the composition of the natural uranium
-  // (ie. U-235+U-238/TotalMass)
-  double pop_qty = inventory.quantity();
-  Material::Ptr natu_matl = inventory.Pop(pop_qty, cyclus::eps_rsrc());
-  inventory.Push(natu_matl);
-
-  cyclus::toolkit::MatQuery mq(natu_matl);
-  std::set<cyclus::Nuc> nucs;
-  nucs.insert(922350000);
-  nucs.insert(922380000);
-  double natu_frac = mq.mass_frac(nucs);
+  // (ie. U-235+U-238/TotalMass) from the running inventory tallies
+  double natu_frac = FeedNatUFrac_();
   double feed_req = natu_req / natu_frac;
 
   // pop amount from inventory and blob it into one material
@@ -439,18 +709,33 @@ cyclus::Material::Ptr Enrichment::Enrich_(cyclus::Material::Ptr mat,
        << nc.convert(mat);
     throw cyclus::ValueError(Agent::InformErrorMsg(ss.str()));
   }
+  if (inventory.empty()) {
+    feed_u235_ = 0;
+    feed_u238_ = 0;
+    feed_total_ = 0;
+  } else if (feed_tally_valid_) {
+    TallyFeed_(r, -1);
+  }
 
   // "enrich" it, but pull out the composition and quantity we require from the
   // blob
   cyclus::Composition::Ptr comp = mat->comp();
   Material::Ptr response = r->ExtractComp(qty, comp);
   tails.Push(r);
+  tails_offers_valid_ = false;
+  if (tails_compaction_threshold > 0 &&
+      tails.count() > tails_compaction_lots_ + tails_compaction_threshold) {
+    CompactTails_();
+  }
 
   current_swu_capacity -= swu_req;
 
   intra_timestep_swu_ += swu_req;
   intra_timestep_feed_ += feed_req;
-  RecordEnrichment_(feed_req, swu_req);
+  intra_timestep_enrichments_++;
+  if (enrichment_records == "trade") {
+    RecordEnrichment_(feed_req, swu_req);
+  }
 
   LOG(cyclus::LEV_INFO5, "EnrFac") << prototype()
                                    << " has performed an enrichment: ";
@@ -489,18 +774,239 @@ void Enrichment::RecordEnrichment_(double natural_u, double swu) {
       ->AddVal("SWU", swu)
       ->Record();
 }
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Enrichment::PrimeConversions_(
+    const std::vector<cyclus::Material::Ptr>& offers, double feed_assay) {
+  // offers share interned compositions, each is computed once
+  ArenaAllocator<char> alloc(&scratch_);
+  std::set<int, std::less<int>, ArenaAllocator<int> > queued(std::less<int>(),
+                                                             alloc);
+  IdVec ids(alloc);
+  std::vector<double, ArenaAllocator<double> > uranium(alloc);
+  batch_.Clear();
+  for (int i = 0; i < offers.size(); i++) {
+    int id = offers[i]->comp()->id();
+    if (conversion_cache_->Contains(id, feed_assay, tails_assay) ||
+        !queued.insert(id).second) {
+      continue;
+    }
+    UraniumMassView u(offers[i]);
+    if (u.assay() <= 0 || u.assay() >= 1) {
+      continue;  // left to the scalar path
+    }
+    ids.push_back(id);
+    uranium.push_back(u.uranium());
+    batch_.Add(1, u.assay());
+  }
+  batch_.Compute(feed_assay, tails_assay);
+
+  for (int i = 0; i < ids.size(); i++) {
+    ConversionCache::Coeffs c;
+    c.swu = batch_.swu[i];
+    c.natu = batch_.feed[i] / uranium[i];
+    conversion_cache_->Put(ids[i], feed_assay, tails_assay, c);
+  }
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 double Enrichment::FeedAssay() {
-  using cyclus::Material;
+  TraceSpan span(this, "FeedAssay");
+  if (inventory.empty()) {
+    return 0;
+  }
+  CheckFeedTally_();
+  double u = feed_u235_ + feed_u238_;
+  return u > 0 ? feed_u235_ / u : 0;
+}
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+double Enrichment::FeedNatUFrac_() {
   if (inventory.empty()) {
     return 0;
   }
-  double pop_qty = inventory.quantity();
-  cyclus::Material::Ptr fission_matl =
-      inventory.Pop(pop_qty, cyclus::eps_rsrc());
-  inventory.Push(fission_matl);
-  return cyclus::toolkit::UraniumAssayMass(fission_matl);
+  CheckFeedTally_();
+  return feed_total_ > 0 ? (feed_u235_ + feed_u238_) / feed_total_ : 0;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Enrichment::TallyFeed_(cyclus::Material::Ptr mat, double sign) {
+  UraniumMassView u(mat);
+  double qty = sign * mat->quantity();
+  feed_u235_ += u.u235() * qty;
+  feed_u238_ += u.u238() * qty;
+  feed_total_ += qty;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Enrichment::CheckFeedTally_() {
+  using cyclus::toolkit::MatVec;
+
+  if (feed_tally_valid_) {
+    return;
+  }
+  feed_u235_ = 0;
+  feed_u238_ = 0;
+  feed_total_ = 0;
+  MatVec mats = inventory.PopN(inventory.count());
+  inventory.Push(mats);
+  for (int i = 0; i < mats.size(); i++) {
+    TallyFeed_(mats[i], 1);
+  }
+  feed_tally_valid_ = true;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+long Enrichment::TailsBin_(cyclus::Material::Ptr mat) {
+  double assay = UraniumMassView(mat).assay();
+  return static_cast<long>(std::floor(assay / tails_bin_width));
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+cyclus::toolkit::MatVec Enrichment::BinTails_(
+    const cyclus::toolkit::MatVec& mats, std::vector<long>* bin_ids) {
+  using cyclus::CompMap;
+  using cyclus::Composition;
+  using cyclus::Material;
+
+  // bin index -> (total quantity, mass-weighted composition)
+  typedef std::pair<const long, std::pair<double, CompMap> > Bin;
+  typedef std::map<long, std::pair<double, CompMap>, std::less<long>,
+                   ArenaAllocator<Bin> > BinMap;
+  BinMap bins(std::less<long>(), ArenaAllocator<Bin>(&scratch_));
+  for (int k = 0; k < mats.size(); k++) {
+    CompMap cm = mats[k]->comp()->mass();
+    cyclus::compmath::Normalize(&cm, mats[k]->quantity());
+    std::pair<double, CompMap>& bin = bins[TailsBin_(mats[k])];
+    bin.first += mats[k]->quantity();
+    bin.second = cyclus::compmath::Add(bin.second, cm);
+  }
+
+  cyclus::toolkit::MatVec binned;
+  bin_ids->clear();
+  BinMap::iterator it;
+  for (it = bins.begin(); it != bins.end(); ++it) {
+    binned.push_back(Material::CreateUntracked(
+        it->second.first, Composition::CreateFromMass(it->second.second)));
+    bin_ids->push_back(it->first);
+  }
+  return binned;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+const cyclus::toolkit::MatVec& Enrichment::TailsOffers_() {
+  if (!tails_offers_valid_ || tails_offers_binned_ != aggregate_tails_bids) {
+    tails_offers_ = tails.PopN(tails.count());
+    tails.Push(tails_offers_);
+    if (aggregate_tails_bids) {
+      tails_offers_ = BinTails_(tails_offers_, &tails_offer_bins_);
+    }
+    tails_offers_valid_ = true;
+    tails_offers_binned_ = aggregate_tails_bids;
+  }
+  return tails_offers_;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Enrichment::IndexTailsLots_(const cyclus::toolkit::MatVec& lots,
+                                 TailsLotIndex* index) {
+  index->clear();
+  if (!tails_offers_binned_) {
+    for (int k = 0; k < lots.size(); k++) {
+      (*index)[lots[k].get()].push_back(k);
+    }
+    return;
+  }
+
+  // bin every lot once, then hand each aggregated offer the lots of its bin
+  std::map<long, std::vector<int> > bin_lots;
+  for (int k = 0; k < lots.size(); k++) {
+    bin_lots[TailsBin_(lots[k])].push_back(k);
+  }
+  for (int k = 0; k < tails_offers_.size(); k++) {
+    std::map<long, std::vector<int> >::const_iterator it =
+        bin_lots.find(tails_offer_bins_[k]);
+    if (it != bin_lots.end()) {
+      (*index)[tails_offers_[k].get()] = it->second;
+    }
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+cyclus::Material::Ptr Enrichment::TakeTails_(double qty,
+                                             const std::vector<int>& own,
+                                             cyclus::toolkit::MatVec* lots) {
+  using cyclus::Material;
+
+  Material::Ptr response;
+  double left = qty;
+  // the lots behind the offer first, then any other lot
+  int nown = own.size();
+  for (int i = 0; i < nown + lots->size() && left > cyclus::eps_rsrc(); i++) {
+    Material::Ptr& lot = (*lots)[i < nown ? own[i] : i - nown];
+    if (!lot) {
+      continue;
+    }
+    Material::Ptr piece;
+    if (lot->quantity() <= left + cyclus::eps_rsrc()) {
+      piece = lot;
+      lot = Material::Ptr();
+    } else {
+      piece = lot->ExtractQty(left);
+    }
+    left -= piece->quantity();
+    if (response) {
+      response->Absorb(piece);
+    } else {
+      response = piece;
+    }
+  }
+  return response;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Enrichment::CompactTails_() {
+  using cyclus::Material;
+  using cyclus::toolkit::MatVec;
+
+  int lots_before = tails.count();
+  if (lots_before < 2) {
+    return;
+  }
+
+  MatVec mats = tails.PopN(lots_before);
+  typedef std::pair<const long, Material::Ptr> Bin;
+  typedef std::map<long, Material::Ptr, std::less<long>, ArenaAllocator<Bin> >
+      BinMap;
+  BinMap bins(std::less<long>(), ArenaAllocator<Bin>(&scratch_));
+  BinMap::iterator it;
+  for (int k = 0; k < mats.size(); k++) {
+    long bin = TailsBin_(mats[k]);
+    it = bins.find(bin);
+    if (it == bins.end()) {
+      bins[bin] = mats[k];
+    } else {
+      it->second->Absorb(mats[k]);
+    }
+  }
+  for (it = bins.begin(); it != bins.end(); ++it) {
+    tails.Push(it->second);
+  }
+  tails_offers_valid_ = false;
+  tails_compaction_lots_ = tails.count();
+  if (tails.count() == lots_before) {
+    return;
+  }
+
+  LOG(cyclus::LEV_INFO4, "EnrFac") << prototype() << " compacted its tails "
+                                   << "from " << lots_before << " to "
+                                   << tails.count() << " lots";
+  context()->NewDatum("TailsCompactions")
+      ->AddVal("AgentId", id())
+      ->AddVal("Time", context()->time())
+      ->AddVal("LotsBefore", lots_before)
+      ->AddVal("LotsAfter", tails.count())
+      ->AddVal("Quantity", tails.quantity())
+      ->Record();
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
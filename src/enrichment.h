@@ -1,21 +1,140 @@
 #ifndef FLEXMORE_SRC_ENRICHMENT_H_
 #define FLEXMORE_SRC_ENRICHMENT_H_
 
-#include <vector>
+#include <cmath>
+#include <list>
+#include <map>
+#include <set>
 #include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
 
 #include "cyclus.h"
 
+#include "arena.h"
+#include "composition_interner.h"
+#include "enrichment_batch.h"
+#include "instrumentation.h"
+#include "schedule.h"
+#include "uranium_view.h"
+
 namespace flexmore {
 
+/// @class ConversionCache
+///
+/// @brief The ConversionCache memoizes the SWU and natural uranium required
+/// per unit of product, keyed by the product composition and the feed and
+/// tails assays. Both quantities are linear in the product quantity, so a
+/// conversion of a material whose composition has been seen before reduces
+/// to a multiplication. Assays are quantized as in the CompositionInterner,
+/// so that round-off drift in the feed assay does not create new entries,
+/// and the least recently used entry is evicted when the cache is full.
+class ConversionCache {
+ public:
+  typedef boost::shared_ptr<ConversionCache> Ptr;
+
+  /// @brief SWU and natural uranium required per unit of product
+  struct Coeffs {
+    double swu;
+    double natu;
+  };
+
+  /// @param max_size the maximum number of cached compositions and assays
+  /// @param quantum the resolution at which feed and tails assays are
+  /// compared
+  explicit ConversionCache(int max_size = 10000, double quantum = 1e-12)
+      : max_size_(max_size),
+        quantum_(quantum),
+        hits_(0),
+        misses_(0),
+        evictions_(0) {}
+
+  /// @returns true if the coefficients of the composition are cached
+  bool Contains(int comp_id, double feed, double tails) const {
+    return index_.count(MakeKey_(comp_id, feed, tails)) > 0;
+  }
+
+  /// @brief stores coefficients computed elsewhere, e.g. in a batch
+  void Put(int comp_id, double feed, double tails, const Coeffs& c) {
+    Key key = MakeKey_(comp_id, feed, tails);
+    std::map<Key, LruList::iterator>::iterator it = index_.find(key);
+    if (it != index_.end()) {
+      it->second->second = c;
+      lru_.splice(lru_.begin(), lru_, it->second);
+      return;
+    }
+    Insert_(key, c);
+  }
+
+  /// @brief computes the per-unit coefficients of a product material
+  static Coeffs Compute(cyclus::Material::Ptr m, double feed, double tails) {
+    UraniumMassView u(m);
+    cyclus::toolkit::Assays assays(feed, u.assay(), tails);
+
+    Coeffs c;
+    c.swu = cyclus::toolkit::SwuRequired(1, assays);
+    c.natu = cyclus::toolkit::FeedQty(1, assays) / u.uranium();
+    return c;
+  }
+
+  /// @returns the per-unit coefficients of the material's composition,
+  /// computing and storing them on first use
+  const Coeffs& Get(cyclus::Material::Ptr m, double feed, double tails) {
+    Key key = MakeKey_(m->comp()->id(), feed, tails);
+    std::map<Key, LruList::iterator>::iterator it = index_.find(key);
+    if (it != index_.end()) {
+      ++hits_;
+      lru_.splice(lru_.begin(), lru_, it->second);
+      return it->second->second;
+    }
+    ++misses_;
+    return Insert_(key, Compute(m, feed, tails));
+  }
+
+  inline long hits() const { return hits_; }
+  inline long misses() const { return misses_; }
+  inline long evictions() const { return evictions_; }
+  inline int size() const { return index_.size(); }
+
+ private:
+  typedef std::pair<int, std::pair<long long, long long> > Key;
+  typedef std::list<std::pair<Key, Coeffs> > LruList;
+
+  Key MakeKey_(int comp_id, double feed, double tails) const {
+    return Key(comp_id, std::make_pair(std::llround(feed / quantum_),
+                                       std::llround(tails / quantum_)));
+  }
+
+  const Coeffs& Insert_(const Key& key, const Coeffs& c) {
+    lru_.push_front(std::make_pair(key, c));
+    index_[key] = lru_.begin();
+    if (static_cast<int>(lru_.size()) > max_size_) {
+      index_.erase(lru_.back().first);
+      lru_.pop_back();
+      ++evictions_;
+    }
+    return lru_.front().second;
+  }
+
+  LruList lru_;
+  std::map<Key, LruList::iterator> index_;
+  int max_size_;
+  double quantum_;
+  long hits_, misses_, evictions_;
+};
+
 /// @class SWUConverter
 ///
 /// @brief The SWUConverter is a simple Converter class for material to
 /// determine the amount of SWU required for their proposed enrichment
 class SWUConverter : public cyclus::Converter<cyclus::Material> {
  public:
-  SWUConverter(double feed_commod, double tails) : feed_(feed_commod),
-    tails_(tails) {}
+  SWUConverter(double feed_commod, double tails,
+               ConversionCache::Ptr cache = ConversionCache::Ptr(),
+               const cyclus::Agent* owner = NULL)
+    : feed_(feed_commod), tails_(tails), cache_(cache), owner_(owner) {}
   virtual ~SWUConverter() {}
 
   /// @brief provides a conversion for the SWU required
@@ -24,9 +143,11 @@ class SWUConverter : public cyclus::Converter<cyclus::Material> {
       cyclus::Arc const * a = NULL,
       cyclus::ExchangeTranslationContext<cyclus::Material>
           const * ctx = NULL) const {
-    cyclus::toolkit::Assays assays(feed_, cyclus::toolkit::UraniumAssayMass(m),
-                                   tails_);
-    return cyclus::toolkit::SwuRequired(m->quantity(), assays);
+    TraceSpan span(owner_, "SWUConverter::convert", "converter");
+    if (cache_) {
+      return m->quantity() * cache_->Get(m, feed_, tails_).swu;
+    }
+    return m->quantity() * ConversionCache::Compute(m, feed_, tails_).swu;
   }
 
   /// @returns true if Converter is a SWUConverter and feed and tails equal
@@ -39,6 +160,8 @@ class SWUConverter : public cyclus::Converter<cyclus::Material> {
 
  private:
   double feed_, tails_;
+  ConversionCache::Ptr cache_;
+  const cyclus::Agent* owner_;  // only used to tag trace spans
 };
 
 /// @class NatUConverter
@@ -48,8 +171,10 @@ class SWUConverter : public cyclus::Converter<cyclus::Material> {
 /// enrichment
 class NatUConverter : public cyclus::Converter<cyclus::Material> {
  public:
-  NatUConverter(double feed_commod, double tails) : feed_(feed_commod),
-    tails_(tails) {}
+  NatUConverter(double feed_commod, double tails,
+                ConversionCache::Ptr cache = ConversionCache::Ptr(),
+                const cyclus::Agent* owner = NULL)
+    : feed_(feed_commod), tails_(tails), cache_(cache), owner_(owner) {}
   virtual ~NatUConverter() {}
 
   /// @brief provides a conversion for the amount of natural Uranium required
@@ -58,16 +183,11 @@ class NatUConverter : public cyclus::Converter<cyclus::Material> {
       cyclus::Arc const * a = NULL,
       cyclus::ExchangeTranslationContext<cyclus::Material>
           const * ctx = NULL) const {
-    cyclus::toolkit::Assays assays(feed_, cyclus::toolkit::UraniumAssayMass(m),
-                                   tails_);
-    cyclus::toolkit::MatQuery mq(m);
-    std::set<cyclus::Nuc> nucs;
-    nucs.insert(922350000);
-    nucs.insert(922380000);
-
-    double natu_frac = mq.mass_frac(nucs);
-    double natu_req = cyclus::toolkit::FeedQty(m->quantity(), assays);
-    return natu_req / natu_frac;
+    TraceSpan span(owner_, "NatUConverter::convert", "converter");
+    if (cache_) {
+      return m->quantity() * cache_->Get(m, feed_, tails_).natu;
+    }
+    return m->quantity() * ConversionCache::Compute(m, feed_, tails_).natu;
   }
 
   /// @returns true if Converter is a NatUConverter and feed and tails equal
@@ -80,6 +200,8 @@ class NatUConverter : public cyclus::Converter<cyclus::Material> {
 
  private:
   double feed_, tails_;
+  ConversionCache::Ptr cache_;
+  const cyclus::Agent* owner_;  // only used to tag trace spans
 };
 
 ///  The Enrichment facility is a simple Agent that enriches natural
@@ -111,7 +233,8 @@ class NatUConverter : public cyclus::Converter<cyclus::Material> {
 ///
 ///  The Enrichment facility also offers its tails as an output commodity with
 ///  no associated recipe.  Bids for tails are constrained only by total
-///  tails inventory.
+///  tails inventory.  Tails lots are either offered individually or, if
+///  aggregate_tails_bids is set, merged into one offer per tails assay bin.
 
 class Enrichment
   : public cyclus::Facility,
@@ -229,6 +352,8 @@ class Enrichment
 
   inline void SwuCapacity(std::vector<double> capacity) {
     swu_vector = capacity;
+    swu_runs.clear();
+    swu_schedule_ = Schedule(capacity);
   }
   
   inline void SwuCapacity(double capacity) {
@@ -242,6 +367,17 @@ class Enrichment
     return tails;
   }
 
+  /// @returns the cache shared by this facility's SWU and NatU converters,
+  /// whose hit and miss counters can be used for tuning
+  inline const ConversionCache& Conversions() const {
+    return *conversion_cache_;
+  }
+
+  /// @returns the table of compositions shared by this facility's offers
+  inline const CompositionInterner& OfferCompositions() const {
+    return offer_comps_;
+  }
+
  private:
   ///   @brief adds a material into the natural uranium inventory
   ///   @throws if the material is not the same composition as the feed_recipe
@@ -259,11 +395,80 @@ class Enrichment
   ///  @param req the requested material being responded to
   cyclus::Material::Ptr Offer_(cyclus::Material::Ptr req);
 
-  cyclus::Material::Ptr Enrich_(cyclus::Material::Ptr mat, double qty);
+  ///  @brief validates a product request and generates its offer
+  ///
+  ///  @return the offer, or NULL if the request cannot be served
+  cyclus::Material::Ptr ValidOffer_(cyclus::Material::Ptr req);
+
+  ///  @brief returns ValidOffer_ of a product request, reusing the
+  ///  validation of an earlier request with the same composition and
+  ///  quantity. Reused offers are fresh untracked materials of the cached
+  ///  composition, so no material is shared between time steps.
+  ///
+  ///  @param reused set to whether an earlier result was reused
+  cyclus::Material::Ptr ReuseOffer_(cyclus::Material::Ptr req, bool* reused);
+
+  ///  @brief enriches qty of the offered material from the feed inventory
+  ///
+  ///  @param batch if given, holds the SWU and feed of this enrichment at
+  ///  index k, which are used unless the feed assay changed since the batch
+  ///  was computed
+  cyclus::Material::Ptr Enrich_(cyclus::Material::Ptr mat, double qty,
+                                const EnrichmentBatch* batch = NULL,
+                                int k = 0);
+
+  ///  @brief computes the conversion coefficients of all offered
+  ///  compositions that are not cached yet in one batch
+  void PrimeConversions_(const std::vector<cyclus::Material::Ptr>& offers,
+                         double feed_assay);
 
   ///  @brief calculates the feed assay based on the unenriched inventory
   double FeedAssay();
 
+  ///  @brief the mass fraction of U-235 and U-238 in the feed inventory
+  double FeedNatUFrac_();
+
+  ///  @brief adds (sign = 1) or removes (sign = -1) the uranium content of a
+  ///  material to the running feed inventory tallies
+  void TallyFeed_(cyclus::Material::Ptr mat, double sign);
+
+  ///  @brief recomputes the feed inventory tallies from the inventory
+  ///  buffer if they are not up to date
+  void CheckFeedTally_();
+
+  ///  @brief the index of the tails assay bin a material falls into, based
+  ///  on its U-235 to U-235+U-238 mass ratio and tails_bin_width
+  long TailsBin_(cyclus::Material::Ptr mat);
+
+  ///  @brief merges the given tails lots into one untracked material per
+  ///  tails assay bin, for use as aggregated tails offers
+  ///
+  ///  @param bins set to the bin index of each returned material
+  cyclus::toolkit::MatVec BinTails_(const cyclus::toolkit::MatVec& mats,
+                                    std::vector<long>* bins);
+
+  typedef std::map<const cyclus::Material*, std::vector<int> > TailsLotIndex;
+
+  ///  @brief maps each tails offer of the last GetMatlBids to the indices in
+  ///  lots of the lots it stands for: the lot itself, or the lots of its
+  ///  assay bin if the offers were aggregated
+  void IndexTailsLots_(const cyclus::toolkit::MatVec& lots,
+                       TailsLotIndex* index);
+
+  ///  @brief takes qty of tails out of lots, drawing from the lots at the
+  ///  indices own first and from the other lots only if those run out
+  cyclus::Material::Ptr TakeTails_(double qty, const std::vector<int>& own,
+                                   cyclus::toolkit::MatVec* lots);
+
+  ///  @brief the tails offered in GetMatlBids: a snapshot of the tails lots,
+  ///  or their assay bins if aggregate_tails_bids is set. The snapshot is
+  ///  reused until the tails buffer changes.
+  const cyclus::toolkit::MatVec& TailsOffers_();
+
+  ///  @brief merges all tails lots that fall into the same tails assay bin
+  ///  and records how much the tails buffer shrank
+  void CompactTails_();
+
   ///  @brief records and enrichment with the cyclus::Recorder
   void RecordEnrichment_(double natural_u, double swu);
 
@@ -356,28 +561,200 @@ class Enrichment
            "so that EF chooses higher U235 content first" \
   }
   bool order_prefs;
-  
+
+  #pragma cyclus var { \
+    "default": 0, \
+    "userlevel": 10, \
+    "tooltip": "aggregate tails bids by assay", \
+    "uilabel": "Aggregate tails bids", \
+    "doc": "If true, tails are offered as one bid per tails assay bin and " \
+           "request instead of one bid per tails lot and request, which " \
+           "keeps the exchange small when many tails lots accumulate." \
+  }
+  bool aggregate_tails_bids;
+
+  #pragma cyclus var { \
+    "default": 1e-4, \
+    "userlevel": 10, \
+    "tooltip": "width of a tails assay bin", \
+    "uilabel": "Tails assay bin width", \
+    "doc": "Width of the bins (in U235 mass fraction) used to group tails " \
+           "lots of similar assay. Has to be strictly positive.", \
+  }
+  double tails_bin_width;
+
+  #pragma cyclus var { \
+    "default": 0, \
+    "userlevel": 10, \
+    "tooltip": "compact tails at the end of each time step", \
+    "uilabel": "Compact tails", \
+    "doc": "If true, tails lots that fall into the same assay bin (see " \
+           "tails_bin_width) are merged into a single lot at every tock." \
+  }
+  bool compact_tails;
+
+  #pragma cyclus var { \
+    "default": 0, \
+    "userlevel": 10, \
+    "tooltip": "tails lot count that triggers a compaction", \
+    "uilabel": "Tails compaction threshold", \
+    "doc": "If strictly positive, tails lots are merged by assay bin as " \
+           "soon as more than this many lots have been added to the tails " \
+           "buffer since the last compaction. Zero disables the threshold.", \
+  }
+  int tails_compaction_threshold;
+
   #pragma cyclus var { \
     "tooltip": "SWU list", \
     "doc": "List of separative work unit (SWU) capacities of enrichment" \
            "for each time step. If there is only one element in the list, " \
            "then this value is used for all timesteps. Else, the length " \
            "of the list has to be identical to the duration of the " \
-           "simulation. All values have to be strictly positive.", \
+           "simulation, unless swu_runs is given. All values have to be " \
+           "strictly positive.", \
     "default": [1e299], \
     "uilabel": "SWU capacity list", \
     "uitype": "oneormore", \
     "units": "kgSWU/time step", \
   }
   std::vector<double> swu_vector;
+
+  #pragma cyclus var { \
+    "default": [], \
+    "userlevel": 10, \
+    "tooltip": "time steps of each swu_vector entry", \
+    "uilabel": "SWU capacity run lengths", \
+    "doc": "Number of time steps for which each entry of swu_vector " \
+           "holds. If given, it has as many entries as swu_vector and sums " \
+           "to the duration of the simulation. If empty, each entry holds " \
+           "for one time step. A per time step swu_vector is stored as " \
+           "runs of equal values on entering the simulation.", \
+    "uitype": "oneormore", \
+  }
+  std::vector<int> swu_runs;
+  // swu_vector and swu_runs as a schedule
+  Schedule swu_schedule_;
   double swu_capacity;
   double current_swu_capacity;
  
+  #pragma cyclus var { \
+    "default": "trade", \
+    "userlevel": 10, \
+    "tooltip": "granularity of the Enrichments table", \
+    "uilabel": "Enrichment records", \
+    "doc": "Granularity at which enrichments are written to the " \
+           "Enrichments table: 'trade' records one row per enrichment, " \
+           "'timestep' records one row per time step with the summed " \
+           "natural uranium and SWU, and 'none' records nothing.", \
+  }
+  std::string enrichment_records;
+
+  #pragma cyclus var { \
+    "default": 0, \
+    "userlevel": 10, \
+    "tooltip": "record callback timings", \
+    "uilabel": "Record timings", \
+    "doc": "If true, the wall time spent in each callback of this agent is " \
+           "written to the AgentTimings table at every time step." \
+  }
+  bool record_timings;
+
+  #pragma cyclus var { \
+    "default": 0, \
+    "userlevel": 10, \
+    "tooltip": "record exchange footprint", \
+    "uilabel": "Record exchange footprint", \
+    "doc": "If true, the number of requests, bids, constraints and trades " \
+           "this agent contributed to the exchange is written to the " \
+           "ExchangeFootprint table at every time step." \
+  }
+  bool record_exchange_footprint;
+
+  #pragma cyclus var { \
+    "default": 0, \
+    "userlevel": 10, \
+    "tooltip": "reuse product offers across time steps", \
+    "uilabel": "Reuse bids", \
+    "doc": "If true, product requests are fingerprinted by composition and " \
+           "quantity, and a request with a fingerprint seen in the previous " \
+           "time step reuses its validation result and offered " \
+           "composition. The number of reused offers is written to the " \
+           "BidReuse table at every time step." \
+  }
+  bool reuse_bids;
+
   // Used to total intra-timestep swu and natu usage for 
   // meeting requests. These help enable time series generation.
   double intra_timestep_swu_;
   double intra_timestep_feed_;
- 
+  int intra_timestep_enrichments_;
+
+  // Exchange counts of the current time step
+  ExchangeFootprint footprint_;
+
+  // Running U-235, U-238 and total masses held in the feed inventory. They
+  // are rebuilt from the buffer on first use (e.g. after a restart) and
+  // kept up to date by AddMat_ and Enrich_ afterwards.
+  double feed_u235_;
+  double feed_u238_;
+  double feed_total_;
+  bool feed_tally_valid_;
+
+  // per-unit SWU and natu coefficients shared by the converters handed to
+  // the exchange in every time step
+  ConversionCache::Ptr conversion_cache_;
+
+  // product compositions offered by Offer_, shared across requests and
+  // time steps
+  CompositionInterner offer_comps_;
+
+  // tails offers of the last GetMatlBids, valid until tails are pushed or
+  // popped, whether they were binned and, if so, the bin of each offer
+  cyclus::toolkit::MatVec tails_offers_;
+  bool tails_offers_valid_;
+  bool tails_offers_binned_;
+  std::vector<long> tails_offer_bins_;
+
+  // lots left in the tails buffer by the last compaction (or fewer, once
+  // some are traded away); tails_compaction_threshold counts the lots
+  // pushed on top of these
+  int tails_compaction_lots_;
+
+  // SWU and natu converters handed to the exchange, reused for as long as
+  // the feed and tails assays they were built for do not change
+  cyclus::Converter<cyclus::Material>::Ptr swu_converter_;
+  cyclus::Converter<cyclus::Material>::Ptr natu_converter_;
+  double converter_feed_assay_;
+  double converter_tails_assay_;
+
+  // SWU and feed of the product trades of one GetMatlTrades, and the
+  // offers whose conversions are primed in GetMatlBids
+  EnrichmentBatch batch_;
+  std::vector<cyclus::Material::Ptr> batch_offers_;
+
+  // offered composition (NULL if the request is invalid) of the product
+  // requests by requested composition id and quantity, with the last time
+  // step each was requested in. Entries not requested in a time step are
+  // dropped at its end.
+  struct ReusedOffer {
+    ReusedOffer() : time(-1) {}
+    cyclus::Composition::Ptr comp;
+    int time;
+  };
+  typedef std::map<std::pair<int, double>, ReusedOffer> ReusedOfferMap;
+  ReusedOfferMap reused_offers_;
+  // tails assay and maximum enrichment the reused offers were validated at
+  double reuse_tails_assay_;
+  double reuse_max_enrich_;
+
+  // backs the scratch containers of AdjustMatlPrefs, BinTails_ and
+  // CompactTails_, reset at every Tick
+  MonotonicArena scratch_;
+
+  // names of the supply and demand time series, built on first use
+  std::string supply_tails_ts_;
+  std::string supply_product_ts_;
+  std::string demand_feed_ts_;
 
   #pragma cyclus var { 'capacity': 'max_feed_inventory' }
   cyclus::toolkit::ResBuf<cyclus::Material> inventory;  // natural u
@@ -385,6 +762,8 @@ class Enrichment
   cyclus::toolkit::ResBuf<cyclus::Material> tails;  // depleted u
 
   friend class EnrichmentTest;
+  friend class EnrichmentBench;
+  friend class AllocTest;
   // ---
 
   #pragma cyclus var { \
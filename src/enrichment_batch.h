@@ -0,0 +1,128 @@
+#ifndef FLEXMORE_SRC_ENRICHMENT_BATCH_H_
+#define FLEXMORE_SRC_ENRICHMENT_BATCH_H_
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace flexmore {
+
+/// @class EnrichmentBatch
+///
+/// @brief The EnrichmentBatch computes the SWU, feed and tails of many
+/// enrichments that share one feed and one tails assay. Inputs and outputs
+/// are held as structure-of-arrays so that Compute runs branch-free loops
+/// of multiplications and additions over contiguous doubles that the
+/// compiler can vectorize.
+///
+/// Compute evaluates the same mass balances and value function as
+/// cyclus::toolkit::SwuRequired, FeedQty and TailsQty, but hoists the feed
+/// and tails value functions and 1 / (x_f - x_t) out of the loop. The
+/// product value function is evaluated in Add, once per distinct product
+/// assay of the batch; products come from interned compositions, so a batch
+/// holds few distinct assays. Results differ from the scalar path by a few
+/// units of rounding only. Feed and tails are within 1e-12 relative of the
+/// scalar path, and the SWU within 1e-12 (|P V(x_p)| + |T V(x_t)| +
+/// |F V(x_f)|), the scale of the cancelling terms of the SWU balance.
+///
+/// Product assays must lie in (0, 1) and the feed assay must differ from
+/// the tails assay. The scalar path rejects other inputs with an exception,
+/// Compute does not check them.
+class EnrichmentBatch {
+ public:
+  EnrichmentBatch() : feed_assay_(-1), tails_assay_(-1) {}
+
+  /// @brief removes all entries, keeping the allocated capacity
+  void Clear() {
+    product_qty.clear();
+    product_assay.clear();
+    product_value.clear();
+    distinct_assays_.clear();
+    distinct_values_.clear();
+    swu.clear();
+    feed.clear();
+    tails.clear();
+  }
+
+  /// @brief appends an enrichment of qty product at the U-235 mass
+  /// fraction (of uranium) assay
+  void Add(double qty, double assay) {
+    product_qty.push_back(qty);
+    product_assay.push_back(assay);
+    product_value.push_back(ProductValue_(assay));
+  }
+
+  /// @returns the number of entries
+  inline int size() const { return product_qty.size(); }
+
+  /// @brief computes swu, feed and tails of all entries
+  void Compute(double feed_assay, double tails_assay) {
+    feed_assay_ = feed_assay;
+    tails_assay_ = tails_assay;
+    int n = product_qty.size();
+    swu.resize(n);
+    feed.resize(n);
+    tails.resize(n);
+    if (n == 0) {
+      return;
+    }
+
+    const double vf = ValueFunc(feed_assay);
+    const double vt = ValueFunc(tails_assay);
+    const double inv = 1 / (feed_assay - tails_assay);
+    const double* p = &product_qty[0];
+    const double* xp = &product_assay[0];
+    const double* vp = &product_value[0];
+    double* s = &swu[0];
+    double* f = &feed[0];
+    double* t = &tails[0];
+    for (int i = 0; i < n; ++i) {
+      f[i] = p[i] * (xp[i] - tails_assay) * inv;
+      t[i] = p[i] * (xp[i] - feed_assay) * inv;
+      s[i] = p[i] * vp[i] + t[i] * vt - f[i] * vf;
+    }
+  }
+
+  /// @returns the feed and tails assays of the last Compute, or -1
+  inline double feed_assay() const { return feed_assay_; }
+  inline double tails_assay() const { return tails_assay_; }
+
+  /// @brief the separative value function V(x) = (1 - 2x) ln((1 - x) / x)
+  static inline double ValueFunc(double x) {
+    return (1 - 2 * x) * std::log(1 / x - 1);
+  }
+
+  // inputs, with the value function of each product assay
+  std::vector<double> product_qty;
+  std::vector<double> product_assay;
+  std::vector<double> product_value;
+
+  // outputs of Compute
+  std::vector<double> swu;
+  std::vector<double> feed;
+  std::vector<double> tails;
+
+ private:
+  /// @returns ValueFunc(assay), evaluated once per distinct assay of the
+  /// batch. The distinct assays are kept sorted for a binary search.
+  double ProductValue_(double assay) {
+    std::vector<double>::iterator it = std::lower_bound(
+        distinct_assays_.begin(), distinct_assays_.end(), assay);
+    int i = it - distinct_assays_.begin();
+    if (it == distinct_assays_.end() || *it != assay) {
+      distinct_assays_.insert(it, assay);
+      distinct_values_.insert(distinct_values_.begin() + i,
+                              ValueFunc(assay));
+    }
+    return distinct_values_[i];
+  }
+
+  double feed_assay_;
+  double tails_assay_;
+  std::vector<double> distinct_assays_;
+  std::vector<double> distinct_values_;
+};
+
+}  // namespace flexmore
+
+#endif  // FLEXMORE_SRC_ENRICHMENT_BATCH_H_
@@ -317,6 +317,80 @@ TEST_F(EnrichmentTest, TradeTails) {
     "Not providing the requested quantity" ;
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(EnrichmentTest, TimestepEnrichmentRecords) {
+  // this tests that per-timestep records aggregate all enrichments of a
+  // time step into a single Enrichments row
+
+  std::string config =
+    "   <feed_commod>natu</feed_commod> "
+    "   <feed_recipe>natu1</feed_recipe> "
+    "   <product_commod>enr_u</product_commod> "
+    "   <tails_commod>tails</tails_commod> "
+    "   <tails_assay>0.003</tails_assay> "
+    "   <initial_feed>1000</initial_feed> "
+    "   <enrichment_records>timestep</enrichment_records> ";
+
+  int simdur = 1;
+  cyclus::MockSim sim(cyclus::AgentSpec
+          (":flexmore:Enrichment"), config, simdur);
+  sim.AddRecipe("natu1", c_natu1());
+  sim.AddRecipe("leu", c_leu());
+
+  sim.AddSink("enr_u")
+    .recipe("leu")
+    .capacity(0.5)
+    .Finalize();
+  sim.AddSink("enr_u")
+    .recipe("leu")
+    .capacity(0.5)
+    .Finalize();
+
+  int id = sim.Run();
+
+  QueryResult qr = sim.db().Query("Enrichments", NULL);
+  // two enrichments of 0.5kg LEU each, 0.5 * (0.04 - 0.003)/(0.007 - 0.003)
+  EXPECT_EQ(1, qr.rows.size());
+  EXPECT_NEAR(9.25, qr.GetVal<double>("Natural_Uranium"), 0.01);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(EnrichmentTest, ExchangeFootprint) {
+  // this tests that the exchange footprint counts the feed request, the
+  // product bids with their SWU and NatU constraints and the trades
+
+  std::string config =
+    "   <feed_commod>natu</feed_commod> "
+    "   <feed_recipe>natu1</feed_recipe> "
+    "   <product_commod>enr_u</product_commod> "
+    "   <tails_commod>tails</tails_commod> "
+    "   <tails_assay>0.003</tails_assay> "
+    "   <initial_feed>1000</initial_feed> "
+    "   <record_exchange_footprint>1</record_exchange_footprint> ";
+
+  int simdur = 1;
+  cyclus::MockSim sim(cyclus::AgentSpec
+          (":flexmore:Enrichment"), config, simdur);
+  sim.AddRecipe("natu1", c_natu1());
+  sim.AddRecipe("leu", c_leu());
+
+  sim.AddSink("enr_u")
+    .recipe("leu")
+    .capacity(0.5)
+    .Finalize();
+
+  int id = sim.Run();
+
+  QueryResult qr = sim.db().Query("ExchangeFootprint", NULL);
+  EXPECT_EQ(1, qr.rows.size());
+  EXPECT_EQ(1, qr.GetVal<int>("RequestsMade"));
+  EXPECT_EQ(1, qr.GetVal<int>("RequestsSeen"));
+  EXPECT_EQ(1, qr.GetVal<int>("Bids"));
+  EXPECT_EQ(2, qr.GetVal<int>("Constraints"));
+  EXPECT_EQ(1, qr.GetVal<int>("TradesReceived"));
+  EXPECT_EQ(1, qr.GetVal<int>("TradesAnswered"));
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 TEST_F(EnrichmentTest, BidPrefs) {
   // This tests that natu sources are preference-ordered by
@@ -473,6 +547,7 @@ void EnrichmentTest::InitParameters() {
   ctx->AddRecipe(feed_recipe, recipe);
 
   tails_assay = 0.002;
+  max_enrich = 1;
   swu_capacity = 100; //**
   inv_size = 5;
 
@@ -503,6 +578,12 @@ void EnrichmentTest::DoAddMat(cyclus::Material::Ptr mat) {
   src_facility->AddMat_(mat);
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void EnrichmentTest::DoAddTails(cyclus::Material::Ptr mat) {
+  src_facility->tails.Push(mat);
+  src_facility->tails_offers_valid_ = false;
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 cyclus::Material::Ptr EnrichmentTest::DoRequest() {
   return src_facility->Request_();
@@ -520,6 +601,46 @@ EnrichmentTest::DoEnrich(cyclus::Material::Ptr mat, double qty) {
   return src_facility->Enrich_(mat, qty);
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+double EnrichmentTest::DoFeedAssay() {
+  return src_facility->FeedAssay();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void EnrichmentTest::AggregateTailsBids(bool aggregate) {
+  src_facility->aggregate_tails_bids = aggregate;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void EnrichmentTest::TailsCompactionThreshold(int nlots) {
+  src_facility->tails_compaction_threshold = nlots;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+int EnrichmentTest::TailsCompactionLots() {
+  return src_facility->tails_compaction_lots_;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void EnrichmentTest::ReuseBids(bool reuse) {
+  src_facility->reuse_bids = reuse;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+cyclus::Material::Ptr EnrichmentTest::DoReuseOffer(cyclus::Material::Ptr mat,
+                                                   bool* reused) {
+  return src_facility->ReuseOffer_(mat, reused);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void EnrichmentTest::AgeReusedOffers() {
+  Enrichment::ReusedOfferMap::iterator it;
+  for (it = src_facility->reused_offers_.begin();
+       it != src_facility->reused_offers_.end(); ++it) {
+    it->second.time--;
+  }
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 TEST_F(EnrichmentTest, Request) {
   // Tests that quantity in material request is accurate
@@ -613,6 +734,201 @@ TEST_F(EnrichmentTest, ValidReq) {
   EXPECT_NEAR(natuc.convert(target) * mass_frac, natuc.convert(offer), 0.001);
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(EnrichmentTest, CachedConverters) {
+  // Tests that converters sharing a cache agree with uncached converters
+  // and only compute the coefficients once per composition
+  using cyclus::Composition;
+  using cyclus::Material;
+
+  cyclus::CompMap v;
+  v[922350000] = 0.05;
+  v[922380000] = 0.95;
+  Composition::Ptr comp = Composition::CreateFromMass(v);
+  Material::Ptr m1 = Material::CreateUntracked(5, comp);
+  Material::Ptr m2 = Material::CreateUntracked(2, comp);
+
+  ConversionCache::Ptr cache(new ConversionCache());
+  SWUConverter swuc(feed_assay, tails_assay);
+  NatUConverter natuc(feed_assay, tails_assay);
+  SWUConverter cached_swuc(feed_assay, tails_assay, cache);
+  NatUConverter cached_natuc(feed_assay, tails_assay, cache);
+
+  EXPECT_NEAR(swuc.convert(m1), cached_swuc.convert(m1), 1e-9);
+  EXPECT_NEAR(natuc.convert(m1), cached_natuc.convert(m1), 1e-9);
+  EXPECT_NEAR(swuc.convert(m2), cached_swuc.convert(m2), 1e-9);
+  EXPECT_NEAR(natuc.convert(m2), cached_natuc.convert(m2), 1e-9);
+  EXPECT_EQ(1, cache->misses());
+  EXPECT_EQ(3, cache->hits());
+
+  // a different tails assay is a different entry
+  SWUConverter other_swuc(feed_assay, 2 * tails_assay, cache);
+  other_swuc.convert(m1);
+  EXPECT_EQ(2, cache->misses());
+  EXPECT_EQ(2, cache->size());
+
+  // a feed assay that drifts by round-off only is the same entry
+  SWUConverter drift_swuc(feed_assay * (1 + 1e-14), tails_assay, cache);
+  drift_swuc.convert(m1);
+  EXPECT_EQ(2, cache->misses());
+  EXPECT_EQ(2, cache->size());
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(EnrichmentTest, ConversionCacheEviction) {
+  // Tests that a full conversion cache evicts its least recently used
+  // entry instead of dropping all entries
+  using cyclus::Material;
+
+  ConversionCache cache(2);
+  std::vector<Material::Ptr> mats;
+  for (int i = 0; i < 3; i++) {
+    cyclus::CompMap v;
+    v[922350000] = 0.03 + 0.01 * i;
+    v[922380000] = 0.97 - 0.01 * i;
+    mats.push_back(Material::CreateUntracked(
+        1, cyclus::Composition::CreateFromMass(v)));
+  }
+  cache.Get(mats[0], feed_assay, tails_assay);
+  cache.Get(mats[1], feed_assay, tails_assay);
+  cache.Get(mats[0], feed_assay, tails_assay);
+  cache.Get(mats[2], feed_assay, tails_assay);
+
+  EXPECT_EQ(2, cache.size());
+  EXPECT_EQ(1, cache.evictions());
+  EXPECT_TRUE(cache.Contains(mats[0]->comp()->id(), feed_assay, tails_assay));
+  EXPECT_FALSE(cache.Contains(mats[1]->comp()->id(), feed_assay,
+                              tails_assay));
+  EXPECT_TRUE(cache.Contains(mats[2]->comp()->id(), feed_assay, tails_assay));
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(EnrichmentTest, BatchAccuracy) {
+  // Tests that the batch calculator stays within its documented bound of
+  // the scalar SWU, feed and tails functions
+  using cyclus::toolkit::Assays;
+
+  EnrichmentBatch batch;
+  for (int i = 0; i < 100; i++) {
+    batch.Add(0.5 + i, 0.003 + 0.009 * i);
+  }
+  batch.Compute(feed_assay, tails_assay);
+  ASSERT_EQ(100, batch.swu.size());
+  for (int i = 0; i < batch.size(); i++) {
+    double p = batch.product_qty[i];
+    Assays assays(feed_assay, batch.product_assay[i], tails_assay);
+    double feed = cyclus::toolkit::FeedQty(p, assays);
+    double tails = cyclus::toolkit::TailsQty(p, assays);
+    double swu = cyclus::toolkit::SwuRequired(p, assays);
+    double scale = std::abs(p * EnrichmentBatch::ValueFunc(assays.Product())) +
+        std::abs(tails * EnrichmentBatch::ValueFunc(tails_assay)) +
+        std::abs(feed * EnrichmentBatch::ValueFunc(feed_assay));
+    EXPECT_NEAR(feed, batch.feed[i], 1e-12 * std::abs(feed));
+    EXPECT_NEAR(tails, batch.tails[i], 1e-12 * std::abs(tails));
+    EXPECT_NEAR(swu, batch.swu[i], 1e-12 * scale);
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(EnrichmentTest, PrimedConversions) {
+  // Tests that many product requests prime the conversion cache in one
+  // batch, with coefficients matching the scalar converters
+  using cyclus::BidPortfolio;
+  using cyclus::CapacityConstraint;
+  using cyclus::Material;
+  using cyclus::Request;
+
+  DoAddMat(GetMat(inv_size));
+  std::vector<cyclus::Composition::Ptr> comps;
+  for (int i = 0; i < 4; i++) {
+    cyclus::CompMap v;
+    v[922350000] = 0.03 + 0.01 * i;
+    v[922380000] = 0.97 - 0.01 * i;
+    comps.push_back(cyclus::Composition::CreateFromMass(v));
+  }
+  cyclus::ExchangeContext<Material> ec;
+  for (int i = 0; i < 32; i++) {
+    ec.AddRequest(Request<Material>::Create(
+        Material::CreateUntracked(1, comps[i % 4]), trader, product_commod));
+  }
+  std::set<BidPortfolio<Material>::Ptr> ports =
+      src_facility->GetMatlBids(ec.commod_requests);
+  const ConversionCache& cache = src_facility->Conversions();
+  EXPECT_EQ(4, cache.size());
+  EXPECT_EQ(0, cache.misses());
+
+  ASSERT_EQ(1, ports.size());
+  BidPortfolio<Material>::Ptr port = *ports.begin();
+  SWUConverter swuc(feed_assay, tails_assay);
+  NatUConverter natuc(feed_assay, tails_assay);
+  std::set<CapacityConstraint<Material> >::const_iterator cit;
+  for (cit = port->constraints().begin(); cit != port->constraints().end();
+       ++cit) {
+    bool is_swu = *cit->converter() == swuc;
+    std::set<cyclus::Bid<Material>*>::const_iterator bit;
+    for (bit = port->bids().begin(); bit != port->bids().end(); ++bit) {
+      Material::Ptr offer = (*bit)->offer();
+      double expected = is_swu ? swuc.convert(offer) : natuc.convert(offer);
+      EXPECT_NEAR(expected, cit->convert(offer), 1e-9);
+    }
+  }
+  EXPECT_EQ(0, cache.misses());
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(EnrichmentTest, UraniumView) {
+  // Tests that the uranium view agrees with MatQuery in both bases, also
+  // for compositions holding other nuclides
+  cyclus::CompMap v;
+  v[922350000] = 0.02;
+  v[922380000] = 0.88;
+  v[10010000] = 0.1;
+  std::vector<Composition::Ptr> comps;
+  comps.push_back(c_leu());
+  comps.push_back(c_nou235());
+  comps.push_back(Composition::CreateFromMass(v));
+  for (int i = 0; i < comps.size(); i++) {
+    Material::Ptr m = Material::CreateUntracked(3, comps[i]);
+    MatQuery q(m);
+    UraniumMassView mass(m);
+    UraniumAtomView atom(m);
+    EXPECT_NEAR(q.mass_frac(922350000), mass.u235(), 1e-12);
+    EXPECT_NEAR(q.mass_frac(922380000), mass.u238(), 1e-12);
+    EXPECT_NEAR(q.atom_frac(922350000), atom.u235(), 1e-12);
+    EXPECT_NEAR(q.atom_frac(922380000), atom.u238(), 1e-12);
+    EXPECT_NEAR(cyclus::toolkit::UraniumAssayMass(m), mass.assay(), 1e-12);
+  }
+  EXPECT_DOUBLE_EQ(0, UraniumMassView(c_nou235()).assay());
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(EnrichmentTest, OfferCompositions) {
+  // Tests that offers for the same enrichment share one composition
+  using cyclus::Material;
+
+  Material::Ptr leu1 = Material::CreateUntracked(1, c_leu());
+  Material::Ptr leu2 = Material::CreateUntracked(2, c_leu());
+  Material::Ptr heu = Material::CreateUntracked(1, c_heu());
+
+  Material::Ptr offer1 = DoOffer(leu1);
+  Material::Ptr offer2 = DoOffer(leu2);
+  Material::Ptr offer3 = DoOffer(heu);
+  EXPECT_EQ(offer1->comp(), offer2->comp());
+  EXPECT_NE(offer1->comp(), offer3->comp());
+  EXPECT_DOUBLE_EQ(2, offer2->quantity());
+
+  const CompositionInterner& comps = src_facility->OfferCompositions();
+  EXPECT_EQ(1, comps.hits());
+  EXPECT_EQ(2, comps.misses());
+  EXPECT_EQ(2, comps.size());
+
+  CompositionInterner small(1);
+  small.Get(0.04, 0.96);
+  small.Get(0.2, 0.8);
+  EXPECT_EQ(1, small.evictions());
+  EXPECT_EQ(1, small.size());
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 TEST_F(EnrichmentTest, Enrich) {
   // this test asks the facility to enrich a material that results in an amount
@@ -662,6 +978,419 @@ TEST_F(EnrichmentTest, Enrich) {
   EXPECT_THROW(response = DoEnrich(target, qty), cyclus::Error);
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(EnrichmentTest, FeedAssayTally) {
+  // Tests that the running feed tallies match the assay of the squashed
+  // inventory when lots of different assays are added and removed.
+  using cyclus::Material;
+  using cyclus::toolkit::UraniumAssayMass;
+
+  src_facility->SetMaxInventorySize(100);
+  EXPECT_DOUBLE_EQ(0, DoFeedAssay());
+
+  DoAddMat(GetMat(10));
+  EXPECT_NEAR(feed_assay, DoFeedAssay(), 1e-12);
+
+  DoAddMat(Material::CreateUntracked(10, c_natu2()));
+  Material::Ptr mix = GetMat(10);
+  mix->Absorb(Material::CreateUntracked(10, c_natu2()));
+  EXPECT_NEAR(UraniumAssayMass(mix), DoFeedAssay(), 1e-12);
+
+  // enriching removes lots from the front of the inventory, leaving only
+  // natu2 behind
+  cyclus::CompMap v;
+  v[922350000] = 0.05;
+  v[922380000] = 0.95;
+  Material::Ptr target = Material::CreateUntracked(
+      1, cyclus::Composition::CreateFromMass(v));
+  cyclus::toolkit::Assays assays(DoFeedAssay(), 0.05, tails_assay);
+  double qty = 10 / cyclus::toolkit::FeedQty(1, assays);
+  DoEnrich(target, qty);
+  EXPECT_NEAR(0.01, DoFeedAssay(), 1e-9);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(EnrichmentTest, EnrichImpureFeed) {
+  // Tests that feed components other than U-235 and U-238 increase the
+  // amount of feed that is removed from the inventory
+  using cyclus::Material;
+  using cyclus::toolkit::Assays;
+  using cyclus::toolkit::FeedQty;
+
+  double product_assay = 0.05;
+  cyclus::CompMap v;
+  v[922350000] = product_assay;
+  v[922380000] = 1 - product_assay;
+  Material::Ptr target = Material::CreateUntracked(
+      1, cyclus::Composition::CreateFromMass(v));
+
+  cyclus::CompMap f;
+  f[922350000] = 0.9 * feed_assay;
+  f[922380000] = 0.9 * (1 - feed_assay);
+  f[80160000] = 0.1;
+  src_facility->SetMaxInventorySize(100);
+  DoAddMat(Material::CreateUntracked(
+      100, cyclus::Composition::CreateFromMass(f)));
+
+  Assays assays(feed_assay, product_assay, tails_assay);
+  double qty = 1;
+  EXPECT_NO_THROW(DoEnrich(target, qty));
+  EXPECT_NEAR(FeedQty(qty, assays) / 0.9, DoRequest()->quantity(), 1e-9);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(EnrichmentTest, AggregatedTailsBids) {
+  // Tests that aggregated tails bidding offers one bid per assay bin and
+  // request instead of one bid per tails lot and request
+  using cyclus::BidPortfolio;
+  using cyclus::ExchangeContext;
+  using cyclus::Material;
+  using cyclus::Request;
+
+  cyclus::CompMap v;
+  v[922350000] = 0.05;
+  v[922380000] = 0.95;
+  Material::Ptr target = Material::CreateUntracked(
+      1, cyclus::Composition::CreateFromMass(v));
+
+  src_facility->SetMaxInventorySize(100);
+  src_facility->SwuCapacity(1e10);
+  DoAddMat(GetMat(100));
+  int nlots = 3;
+  for (int i = 0; i < nlots; i++) {
+    DoEnrich(target, 0.1);
+  }
+  double tails_qty = src_facility->Tails().quantity();
+
+  int nreqs = 2;
+  ExchangeContext<Material> ec;
+  for (int i = 0; i < nreqs; i++) {
+    ec.AddRequest(Request<Material>::Create(GetMat(1), trader, tails_commod));
+  }
+
+  std::set<BidPortfolio<Material>::Ptr> ports =
+      src_facility->GetMatlBids(ec.commod_requests);
+  ASSERT_EQ(1, ports.size());
+  EXPECT_EQ(nlots * nreqs, (*ports.begin())->bids().size());
+
+  AggregateTailsBids(true);
+  ports = src_facility->GetMatlBids(ec.commod_requests);
+  ASSERT_EQ(1, ports.size());
+  ASSERT_EQ(nreqs, (*ports.begin())->bids().size());
+  cyclus::Bid<Material>* bid = *(*ports.begin())->bids().begin();
+  EXPECT_NEAR(tails_qty, bid->offer()->quantity(), 1e-9);
+  EXPECT_EQ(nlots, src_facility->Tails().count());
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(EnrichmentTest, ReuseBids) {
+  // Tests that unchanged product requests reuse the offers of the previous
+  // time step, and that changed ones get a new offer
+  using cyclus::BidPortfolio;
+  using cyclus::Material;
+  using cyclus::Request;
+
+  DoAddMat(GetMat(inv_size));
+  ReuseBids(true);
+  cyclus::CompMap v;
+  v[922350000] = 0.05;
+  v[922380000] = 0.95;
+  cyclus::Composition::Ptr leu = cyclus::Composition::CreateFromMass(v);
+  cyclus::CompMap w;
+  w[922380000] = 1;
+  cyclus::Composition::Ptr du = cyclus::Composition::CreateFromMass(w);
+
+  // a valid and an invalid request, then the valid one with a new quantity
+  Material::Ptr first;
+  bool reused;
+  for (int step = 0; step < 3; step++) {
+    if (step > 0) {
+      AgeReusedOffers();
+      // the requests of the previous step are cached, not the new quantity
+      DoReuseOffer(Material::CreateUntracked(1, leu), &reused);
+      EXPECT_TRUE(reused);
+      DoReuseOffer(Material::CreateUntracked(1, du), &reused);
+      EXPECT_TRUE(reused);
+      if (step == 1) {
+        DoReuseOffer(Material::CreateUntracked(2, leu), &reused);
+        EXPECT_FALSE(reused);
+      }
+    }
+    cyclus::ExchangeContext<Material> ec;
+    ec.AddRequest(Request<Material>::Create(
+        Material::CreateUntracked(step < 2 ? 1 : 2, leu), trader,
+        product_commod));
+    ec.AddRequest(Request<Material>::Create(
+        Material::CreateUntracked(1, du), trader, product_commod));
+    std::set<BidPortfolio<Material>::Ptr> ports =
+        src_facility->GetMatlBids(ec.commod_requests);
+    ASSERT_EQ(1, ports.size());
+    const std::set<cyclus::Bid<Material>*>& bids = (*ports.begin())->bids();
+    ASSERT_EQ(1, bids.size());
+    Material::Ptr offer = (*bids.begin())->offer();
+    if (step == 0) {
+      EXPECT_DOUBLE_EQ(1, offer->quantity());
+      first = offer;
+    } else {
+      // reused offers are fresh materials of the cached composition
+      EXPECT_NE(first, offer);
+      EXPECT_EQ(first->comp(), offer->comp());
+      EXPECT_DOUBLE_EQ(step < 2 ? 1 : 2, offer->quantity());
+    }
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(EnrichmentTest, ReuseBidsReordered) {
+  // Tests that offers are reused by composition and quantity, whatever the
+  // order in which the requests arrive
+  using cyclus::BidPortfolio;
+  using cyclus::Material;
+  using cyclus::Request;
+
+  DoAddMat(GetMat(inv_size));
+  ReuseBids(true);
+  std::vector<cyclus::Composition::Ptr> comps;
+  for (int i = 0; i < 2; i++) {
+    cyclus::CompMap v;
+    v[922350000] = 0.03 + 0.01 * i;
+    v[922380000] = 0.97 - 0.01 * i;
+    comps.push_back(cyclus::Composition::CreateFromMass(v));
+  }
+
+  for (int step = 0; step < 2; step++) {
+    cyclus::ExchangeContext<Material> ec;
+    for (int i = 0; i < 2; i++) {
+      int k = step == 0 ? i : 1 - i;
+      ec.AddRequest(Request<Material>::Create(
+          Material::CreateUntracked(1 + k, comps[k]), trader,
+          product_commod));
+    }
+    std::set<BidPortfolio<Material>::Ptr> ports =
+        src_facility->GetMatlBids(ec.commod_requests);
+    ASSERT_EQ(1, ports.size());
+    const std::set<cyclus::Bid<Material>*>& bids = (*ports.begin())->bids();
+    ASSERT_EQ(2, bids.size());
+    std::set<cyclus::Bid<Material>*>::const_iterator b;
+    for (b = bids.begin(); b != bids.end(); ++b) {
+      Material::Ptr target = (*b)->request()->target();
+      EXPECT_DOUBLE_EQ(target->quantity(), (*b)->offer()->quantity());
+      EXPECT_NEAR(UraniumMassView(target).assay(),
+                  UraniumMassView((*b)->offer()).assay(), 1e-12);
+    }
+
+    // requests of the previous step hit in reverse order, while repeats
+    // within a step are not reuse across time steps
+    AgeReusedOffers();
+    bool reused;
+    for (int k = 1; k >= 0; k--) {
+      DoReuseOffer(Material::CreateUntracked(1 + k, comps[k]), &reused);
+      EXPECT_TRUE(reused);
+      DoReuseOffer(Material::CreateUntracked(1 + k, comps[k]), &reused);
+      EXPECT_FALSE(reused);
+    }
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(EnrichmentTest, AggregatedTailsTrades) {
+  // Tests that a trade on an aggregated tails offer is filled from the lots
+  // of that offer's assay bin, not from the front of the tails buffer
+  using cyclus::BidPortfolio;
+  using cyclus::ExchangeContext;
+  using cyclus::Material;
+  using cyclus::Request;
+  using cyclus::Trade;
+
+  double assays[] = {0.002, 0.0035};
+  for (int i = 0; i < 2; i++) {
+    cyclus::CompMap v;
+    v[922350000] = assays[i];
+    v[922380000] = 1 - assays[i];
+    DoAddTails(Material::CreateUntracked(
+        2, cyclus::Composition::CreateFromMass(v)));
+  }
+  AggregateTailsBids(true);
+
+  ExchangeContext<Material> ec;
+  ec.AddRequest(Request<Material>::Create(GetMat(1), trader, tails_commod));
+  std::set<BidPortfolio<Material>::Ptr> ports =
+      src_facility->GetMatlBids(ec.commod_requests);
+  ASSERT_EQ(1, ports.size());
+  ASSERT_EQ(2, (*ports.begin())->bids().size());
+
+  cyclus::Bid<Material>* second = NULL;
+  std::set<cyclus::Bid<Material>*>::const_iterator it;
+  for (it = (*ports.begin())->bids().begin();
+       it != (*ports.begin())->bids().end(); ++it) {
+    if (UraniumMassView((*it)->offer()).assay() > 0.003) {
+      second = *it;
+    }
+  }
+  ASSERT_TRUE(second != NULL);
+
+  std::vector<Trade<Material> > trades;
+  trades.push_back(Trade<Material>(second->request(), second, 1.5));
+  std::vector<std::pair<Trade<Material>, Material::Ptr> > responses;
+  src_facility->GetMatlTrades(trades, responses);
+  ASSERT_EQ(1, responses.size());
+  EXPECT_NEAR(1.5, responses[0].second->quantity(), 1e-9);
+  EXPECT_NEAR(0.0035, UraniumMassView(responses[0].second).assay(), 1e-9);
+  EXPECT_NEAR(2.5, src_facility->Tails().quantity(), 1e-9);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(EnrichmentTest, TailsTradesAfterProduct) {
+  // Tests that the tails of a time step's product trades are not shipped
+  // on its tails trades, even when the product trades come first
+  using cyclus::BidPortfolio;
+  using cyclus::ExchangeContext;
+  using cyclus::Material;
+  using cyclus::Request;
+  using cyclus::Trade;
+
+  cyclus::CompMap v;
+  v[922350000] = 0.002;
+  v[922380000] = 0.998;
+  DoAddTails(Material::CreateUntracked(
+      2, cyclus::Composition::CreateFromMass(v)));
+  src_facility->SetMaxInventorySize(100);
+  src_facility->SwuCapacity(1e10);
+  DoAddMat(GetMat(100));
+
+  ExchangeContext<Material> ec;
+  ec.AddRequest(Request<Material>::Create(GetMat(1), trader, tails_commod));
+  std::set<BidPortfolio<Material>::Ptr> ports =
+      src_facility->GetMatlBids(ec.commod_requests);
+  ASSERT_EQ(1, ports.size());
+  ASSERT_EQ(1, (*ports.begin())->bids().size());
+  cyclus::Bid<Material>* tails_bid = *(*ports.begin())->bids().begin();
+
+  cyclus::CompMap w;
+  w[922350000] = 0.05;
+  w[922380000] = 0.95;
+  Material::Ptr target = Material::CreateUntracked(
+      1, cyclus::Composition::CreateFromMass(w));
+  Request<Material>* req =
+      Request<Material>::Create(target, trader, product_commod);
+  cyclus::Bid<Material>* bid =
+      cyclus::Bid<Material>::Create(req, target, src_facility);
+
+  // the product trade pushes new tails ahead of the tails trade, which
+  // asks for more than the lot behind its offer
+  std::vector<Trade<Material> > trades;
+  trades.push_back(Trade<Material>(req, bid, 1));
+  trades.push_back(Trade<Material>(tails_bid->request(), tails_bid, 2.5));
+  std::vector<std::pair<Trade<Material>, Material::Ptr> > responses;
+  EXPECT_THROW(src_facility->GetMatlTrades(trades, responses),
+               cyclus::ValueError);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(EnrichmentTest, TailsCompaction) {
+  // Tests that tails lots of the same assay are merged once the lot-count
+  // threshold is crossed, without losing any tails material
+  using cyclus::Material;
+
+  cyclus::CompMap v;
+  v[922350000] = 0.05;
+  v[922380000] = 0.95;
+  Material::Ptr target = Material::CreateUntracked(
+      1, cyclus::Composition::CreateFromMass(v));
+
+  src_facility->SetMaxInventorySize(100);
+  src_facility->SwuCapacity(1e10);
+  DoAddMat(GetMat(100));
+  TailsCompactionThreshold(2);
+
+  DoEnrich(target, 0.1);
+  DoEnrich(target, 0.1);
+  EXPECT_EQ(2, src_facility->Tails().count());
+  double tails_qty = src_facility->Tails().quantity();
+
+  DoEnrich(target, 0.1);
+  EXPECT_EQ(1, src_facility->Tails().count());
+  EXPECT_NEAR(1.5 * tails_qty, src_facility->Tails().quantity(), 1e-9);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(EnrichmentTest, TailsCompactionDistinctBins) {
+  // Tests that a compaction that cannot merge any lots re-arms the
+  // threshold from the lots it left, instead of running on every enrichment
+  using cyclus::Material;
+
+  double assays[] = {0.001, 0.0015, 0.002};
+  for (int i = 0; i < 3; i++) {
+    cyclus::CompMap v;
+    v[922350000] = assays[i];
+    v[922380000] = 1 - assays[i];
+    DoAddTails(Material::CreateUntracked(
+        1, cyclus::Composition::CreateFromMass(v)));
+  }
+
+  cyclus::CompMap v;
+  v[922350000] = 0.05;
+  v[922380000] = 0.95;
+  Material::Ptr target = Material::CreateUntracked(
+      1, cyclus::Composition::CreateFromMass(v));
+
+  src_facility->SetMaxInventorySize(100);
+  src_facility->SwuCapacity(1e10);
+  DoAddMat(GetMat(100));
+  TailsCompactionThreshold(2);
+
+  // four distinct bins: nothing to merge, the next compaction waits for
+  // two more lots on top of these four
+  DoEnrich(target, 0.1);
+  EXPECT_EQ(4, src_facility->Tails().count());
+  EXPECT_EQ(4, TailsCompactionLots());
+
+  DoEnrich(target, 0.1);
+  DoEnrich(target, 0.1);
+  EXPECT_EQ(6, src_facility->Tails().count());
+  EXPECT_EQ(4, TailsCompactionLots());
+
+  // the new tails share one bin and are merged
+  DoEnrich(target, 0.1);
+  EXPECT_EQ(4, src_facility->Tails().count());
+  EXPECT_EQ(4, TailsCompactionLots());
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(EnrichmentTest, AdjustPrefs) {
+  // Tests that feed offers are ranked by U-235 content for every request
+  // and that offers without U-235 are rejected
+  using cyclus::Bid;
+  using cyclus::Material;
+  using cyclus::Request;
+
+  Material::Ptr natu1 = Material::CreateUntracked(1, c_natu1());
+  Material::Ptr natu2 = Material::CreateUntracked(1, c_natu2());
+  Material::Ptr nou235 = Material::CreateUntracked(1, c_nou235());
+
+  cyclus::PrefMap<Material>::type prefs;
+  std::vector<Bid<Material>*> bids;
+  for (int i = 0; i < 2; i++) {
+    Request<Material>* req =
+        Request<Material>::Create(GetMat(1), src_facility, feed_commod);
+    bids.push_back(Bid<Material>::Create(req, natu2, trader));
+    bids.push_back(Bid<Material>::Create(req, nou235, trader));
+    bids.push_back(Bid<Material>::Create(req, natu1, trader));
+    for (int k = bids.size() - 3; k < bids.size(); k++) {
+      prefs[req][bids[k]] = 1;
+    }
+  }
+
+  src_facility->AdjustMatlPrefs(prefs);
+
+  for (int i = 0; i < 2; i++) {
+    Request<Material>* req = bids[3 * i]->request();
+    EXPECT_EQ(3, prefs[req][bids[3 * i]]);
+    EXPECT_EQ(-1, prefs[req][bids[3 * i + 1]]);
+    EXPECT_EQ(2, prefs[req][bids[3 * i + 2]]);
+  }
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 TEST_F(EnrichmentTest, Response) {
   // this test asks the facility to respond to multiple requests for enriched
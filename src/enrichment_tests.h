@@ -37,10 +37,20 @@ class EnrichmentTest : public ::testing::Test {
   /// @param enr the enrichment percent, i.e. for 5 w/o, enr = 0.05
   cyclus::Material::Ptr GetReqMat(double qty, double enr);
   void DoAddMat(cyclus::Material::Ptr mat);
+  void DoAddTails(cyclus::Material::Ptr mat);
   cyclus::Material::Ptr DoRequest();
   cyclus::Material::Ptr DoBid(cyclus::Material::Ptr mat);
   cyclus::Material::Ptr DoOffer(cyclus::Material::Ptr mat);
   cyclus::Material::Ptr DoEnrich(cyclus::Material::Ptr mat, double qty);
+  double DoFeedAssay();
+  void AggregateTailsBids(bool aggregate);
+  void TailsCompactionThreshold(int nlots);
+  int TailsCompactionLots();
+  void ReuseBids(bool reuse);
+  cyclus::Material::Ptr DoReuseOffer(cyclus::Material::Ptr mat, bool* reused);
+  /// @brief makes the cached offers look as if they were requested in the
+  /// previous time step, as the test context does not advance in time
+  void AgeReusedOffers();
   /// @param nreqs the total number of requests
   /// @param nvalid the number of requests that are valid
   boost::shared_ptr< cyclus::ExchangeContext<cyclus::Material> >
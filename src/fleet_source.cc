@@ -0,0 +1,294 @@
+#include "fleet_source.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <map>
+#include <sstream>
+
+namespace flexmore {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+FleetSource::FleetSource(cyclus::Context* ctx)
+    : cyclus::Facility(ctx),
+      record_timings(false),
+      record_exchange_footprint(false) {}
+
+FleetSource::~FleetSource() {}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void FleetSource::InitFrom(FleetSource* m) {
+  #pragma cyclus impl initfromcopy flexmore::FleetSource
+  cyclus::toolkit::CommodityProducer::Copy(m);
+  SetUpMembers_();
+  RecordPosition();
+}
+
+void FleetSource::InitFrom(cyclus::QueryableBackend* b) {
+  #pragma cyclus impl initfromdb flexmore::FleetSource
+  namespace tk = cyclus::toolkit;
+  SetUpMembers_();
+  double total = 0;
+  for (int i = 0; i < nmembers(); i++) {
+    total += throughputs[i];
+  }
+  tk::CommodityProducer::Add(tk::Commodity(outcommod),
+                             tk::CommodInfo(total, total));
+  RecordPosition();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void FleetSource::SetUpMembers_() {
+  int n = nmembers();
+  if (inventories.empty()) {
+    inventories.assign(n, std::numeric_limits<double>::max());
+  }
+  if (latitudes.empty()) {
+    latitudes.assign(n, 0);
+  }
+  if (longitudes.empty()) {
+    longitudes.assign(n, 0);
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void FleetSource::EnterNotify() {
+  cyclus::Facility::EnterNotify();
+  SetUpMembers_();
+
+  int n = nmembers();
+  std::stringstream ss;
+  if (n == 0) {
+    ss << "Prototype '" << prototype() << "' has no members\n";
+  }
+  for (int i = 0; i < n; i++) {
+    if (throughputs[i] < 0 ||
+        throughputs[i] > std::numeric_limits<double>::max()) {
+      ss << "Prototype '" << prototype()
+         << "' has invalid value " << throughputs[i]
+         << " in position " << i << " of throughputs\n";
+    }
+  }
+  if (inventories.size() != n) {
+    ss << "Prototype '" << prototype() << "' has " << inventories.size()
+       << " inventories, expected 0 or " << n << "\n";
+  }
+  if (latitudes.size() != n || longitudes.size() != n) {
+    ss << "Prototype '" << prototype() << "' has " << latitudes.size()
+       << " latitudes and " << longitudes.size()
+       << " longitudes, expected 0 or " << n << " each\n";
+  }
+
+  if (ss.str().size() > 0) {
+    throw cyclus::ValueError(ss.str());
+  }
+  if (!outrecipe.empty()) {
+    outrecipe_comp_ = context()->GetRecipe(outrecipe);
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+std::string FleetSource::str() {
+  std::stringstream ss;
+  ss << cyclus::Facility::str() << " is a fleet of " << nmembers()
+     << " members supplying commodity '" << outcommod
+     << "' with recipe '" << outrecipe << "'";
+  return ss.str();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+cyclus::Composition::Ptr FleetSource::OutComp_(
+    cyclus::Material::Ptr target) {
+  if (outrecipe.empty()) {
+    return target->comp();
+  }
+  if (!outrecipe_comp_) {
+    outrecipe_comp_ = context()->GetRecipe(outrecipe);
+  }
+  return outrecipe_comp_;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void FleetSource::Tick() {
+  PhaseTimer timer(this, "Tick", record_timings);
+  scratch_.Reset();
+  member_supply_.clear();
+  member_shipped_.clear();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void FleetSource::Tock() {
+  // completes the trace file in the last time step, including this Tock
+  TraceFlush flush(this);
+  PhaseTimer timer(this, "Tock", record_timings);
+  RecordMemberSupply_();
+  if (record_exchange_footprint) {
+    footprint_.Record(this);
+  }
+  footprint_.Reset();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+std::set<cyclus::BidPortfolio<cyclus::Material>::Ptr>
+FleetSource::GetMatlBids(
+    cyclus::CommodMap<cyclus::Material>::type& commod_requests) {
+  using cyclus::BidPortfolio;
+  using cyclus::CapacityConstraint;
+  using cyclus::Material;
+  using cyclus::Request;
+  PhaseTimer timer(this, "GetMatlBids", record_timings);
+
+  double total = ResetMemberCapacity_();
+  if (supply_ts_.empty()) {
+    supply_ts_ = "supply" + outcommod;
+  }
+  cyclus::toolkit::RecordTimeSeries<double>(supply_ts_, this, total);
+  LOG(cyclus::LEV_INFO3, "FleetSource") << prototype() << " is bidding up to "
+                                        << total << " kg of " << outcommod
+                                        << " from " << nmembers()
+                                        << " members";
+
+  std::set<BidPortfolio<Material>::Ptr> ports;
+  cyclus::CommodMap<Material>::type::iterator found =
+      commod_requests.find(outcommod);
+  if (found == commod_requests.end() || total < cyclus::eps()) {
+    return ports;
+  }
+  std::vector<Request<Material>*>& requests = found->second;
+  footprint_.requests_seen += requests.size();
+
+  // requests for the same quantity and composition share one offer
+  typedef std::pair<double, int> OfferKey;
+  typedef std::pair<const OfferKey, Material::Ptr> Offer;
+  typedef std::map<OfferKey, Material::Ptr, std::less<OfferKey>,
+                   ArenaAllocator<Offer> > OfferMap;
+  OfferMap offers(std::less<OfferKey>(), ArenaAllocator<Offer>(&scratch_));
+
+  // the members are identical, so the fleet bids as one Source with the
+  // summed capacity of its members
+  BidPortfolio<Material>::Ptr port(new BidPortfolio<Material>());
+  std::vector<Request<Material>*>::iterator it;
+  for (it = requests.begin(); it != requests.end(); ++it) {
+    Material::Ptr target = (*it)->target();
+    double qty = std::min(target->quantity(), total);
+    cyclus::Composition::Ptr comp = OutComp_(target);
+    Material::Ptr& offer = offers[OfferKey(qty, comp->id())];
+    if (!offer) {
+      offer = Material::CreateUntracked(qty, comp);
+    }
+    port->AddBid(*it, offer, this);
+  }
+  port->AddConstraint(CapacityConstraint<Material>(total));
+  ports.insert(port);
+  footprint_.bids += port->bids().size();
+  footprint_.constraints += port->constraints().size();
+
+  return ports;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+double FleetSource::ResetMemberCapacity_() {
+  if (inventories.size() != nmembers()) {
+    SetUpMembers_();
+  }
+  int n = nmembers();
+  member_supply_.resize(n);
+  member_shipped_.assign(n, 0);
+  double total = 0;
+  for (int m = 0; m < n; m++) {
+    member_supply_[m] = std::min(throughputs[m], inventories[m]);
+    total += member_supply_[m];
+  }
+  return total;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void FleetSource::RecordMemberSupply_() {
+  int n = member_supply_.size();
+  for (int m = 0; m < n; m++) {
+    context()
+      ->NewDatum("FleetSupply")
+      ->AddVal("AgentId", id())
+      ->AddVal("Time", context()->time())
+      ->AddVal("Member", m)
+      ->AddVal("Supply", member_supply_[m])
+      ->AddVal("Shipped", member_shipped_[m])
+      ->Record();
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void FleetSource::GetMatlTrades(
+    const std::vector<cyclus::Trade<cyclus::Material> >& trades,
+    std::vector<std::pair<cyclus::Trade<cyclus::Material>,
+                          cyclus::Material::Ptr> >& responses) {
+  using cyclus::Material;
+  PhaseTimer timer(this, "GetMatlTrades", record_timings);
+
+  footprint_.trades_received += trades.size();
+  if (member_supply_.size() != nmembers()) {
+    ResetMemberCapacity_();
+  }
+  int n = nmembers();
+
+  // the members share the trades in proportion to the capacity each has
+  // left, as identical Sources filled in parallel would
+  double total = 0;
+  std::vector<cyclus::Trade<cyclus::Material> >::const_iterator it;
+  for (it = trades.begin(); it != trades.end(); ++it) {
+    total += it->amt;
+  }
+  double left = 0;
+  for (int m = 0; m < n; m++) {
+    left += member_supply_[m] - member_shipped_[m];
+  }
+  if (total > left + cyclus::eps_rsrc()) {
+    std::stringstream ss;
+    ss << "is being asked to provide " << total << " kg, " << total - left
+       << " kg more than its members can supply.";
+    throw cyclus::ValueError(Agent::InformErrorMsg(ss.str()));
+  }
+  double frac = left > 0 ? std::min(1.0, total / left) : 0;
+  for (int m = 0; m < n; m++) {
+    double take = (member_supply_[m] - member_shipped_[m]) * frac;
+    member_shipped_[m] += take;
+    inventories[m] -= take;
+  }
+
+  for (it = trades.begin(); it != trades.end(); ++it) {
+    double qty = it->amt;
+    Material::Ptr response =
+        Material::Create(this, qty, OutComp_(it->request->target()));
+    responses.push_back(std::make_pair(*it, response));
+    footprint_.trades_answered++;
+    LOG(cyclus::LEV_INFO5, "FleetSource") << prototype() << " sent an order"
+                                          << " for " << qty << " of "
+                                          << outcommod;
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void FleetSource::RecordPosition() {
+  std::string specification = this->spec();
+  // inconsistent member arrays are reported by EnterNotify
+  int n = std::min(latitudes.size(), longitudes.size());
+  n = std::min(n, nmembers());
+  for (int m = 0; m < n; m++) {
+    context()
+      ->NewDatum("FleetPosition")
+      ->AddVal("Spec", specification)
+      ->AddVal("Prototype", this->prototype())
+      ->AddVal("AgentId", id())
+      ->AddVal("Member", m)
+      ->AddVal("Latitude", latitudes[m])
+      ->AddVal("Longitude", longitudes[m])
+      ->Record();
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+extern "C" cyclus::Agent* ConstructFleetSource(cyclus::Context* ctx) {
+  return new FleetSource(ctx);
+}
+
+}  // namespace flexmore
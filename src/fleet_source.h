@@ -0,0 +1,210 @@
+#ifndef CYCLUS_FLEXMORE_FLEET_SOURCE_H_
+#define CYCLUS_FLEXMORE_FLEET_SOURCE_H_
+
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cyclus.h"
+
+#include "arena.h"
+#include "instrumentation.h"
+
+namespace flexmore {
+
+/// @class FleetSource
+///
+/// The FleetSource represents a fleet of identical suppliers in one agent.
+/// All members offer the same commodity and recipe, while each member has
+/// its own throughput, inventory and geographical position.
+///
+/// @section agentparams Agent Parameters
+/// The fleet has one member per entry of throughputs. outcommod and
+/// outrecipe are shared by all members.
+///
+/// @section optionalparams Optional Parameters
+/// inventories, latitudes and longitudes hold one value per member. If
+/// empty, members have an unlimited inventory and are placed at (0, 0).
+///
+/// @section detailed Detailed Behavior
+/// Member state is kept as parallel arrays. Since the members are
+/// identical, the fleet bids on every request for outcommod in a single
+/// portfolio, capped by one capacity constraint on the summed capacities
+/// of its members. The exchange therefore sees the bids of one Source
+/// instead of one per member. The trades of a time step are shared among
+/// the members in proportion to the capacity each has left, so that every
+/// member ships its full capacity when the fleet does, as separate Sources
+/// would, and are charged to their inventories. The fleet's total supply
+/// is recorded in the supply time series of outcommod, each member's
+/// supply and shipments in the FleetSupply table and member positions in
+/// the FleetPosition table.
+///
+/// Member throughputs are constant in time. Members whose throughput
+/// changes over time are modeled with flexmore Sources instead.
+class FleetSource : public cyclus::Facility,
+  public cyclus::toolkit::CommodityProducer {
+  friend class FleetSourceTest;
+ public:
+  /// Constructor for FleetSource Class
+  /// @param ctx the cyclus context for access to simulation-wide parameters
+  explicit FleetSource(cyclus::Context* ctx);
+
+  virtual ~FleetSource();
+
+  #pragma cyclus note { \
+    "doc": "A fleet of identical suppliers of one commodity, with " \
+           "per-member throughput, inventory and position.", \
+  }
+
+  #pragma cyclus def clone
+  #pragma cyclus def schema
+  #pragma cyclus def annotations
+  #pragma cyclus def infiletodb
+  #pragma cyclus def snapshot
+  #pragma cyclus def snapshotinv
+  #pragma cyclus def initinv
+
+  virtual void InitFrom(FleetSource* m);
+  virtual void InitFrom(cyclus::QueryableBackend* b);
+  virtual void EnterNotify();
+  virtual std::string str();
+  virtual void Tick();
+  virtual void Tock();
+
+  virtual std::set<cyclus::BidPortfolio<cyclus::Material>::Ptr>
+      GetMatlBids(cyclus::CommodMap<cyclus::Material>::type&
+                  commod_requests);
+
+  virtual void GetMatlTrades(
+    const std::vector<cyclus::Trade<cyclus::Material> >& trades,
+    std::vector<std::pair<cyclus::Trade<cyclus::Material>,
+    cyclus::Material::Ptr> >& responses
+  );
+
+  /// @returns the number of members of the fleet
+  inline int nmembers() const { return throughputs.size(); }
+
+ private:
+  /// @brief fills unset per-member arrays with their defaults
+  void SetUpMembers_();
+
+  void RecordPosition();
+
+  /// @brief sets the supply of each member in the current time step to the
+  /// smaller of its throughput and inventory, with nothing shipped yet
+  /// @returns the total capacity of the fleet
+  double ResetMemberCapacity_();
+
+  /// @brief writes one FleetSupply row per member for the current time step
+  void RecordMemberSupply_();
+
+  /// @returns the composition offered for a request of target: outrecipe's
+  /// composition, resolved once, or the target's if outrecipe is empty
+  cyclus::Composition::Ptr OutComp_(cyclus::Material::Ptr target);
+
+  #pragma cyclus var { \
+    "tooltip": "fleet output commodity", \
+    "doc": "Output commodity on which all members offer material.", \
+    "uilabel": "Output Commodity", \
+    "uitype": "outcommodity", \
+  }
+  std::string outcommod;
+
+  #pragma cyclus var { \
+    "tooltip": "name of material recipe to provide", \
+    "doc": "Name of composition recipe that all members provide regardless " \
+           "of requested composition. If empty, members create and provide " \
+           "whatever compositions are requested.", \
+    "default": "", \
+    "uilabel": "Output Recipe", \
+    "uitype": "outrecipe", \
+  }
+  std::string outrecipe;
+
+  #pragma cyclus var { \
+    "tooltip": "member throughputs", \
+    "doc": "Amount of commodity each member can supply per time step, one " \
+           "entry per member. The length of this list sets the size of the " \
+           "fleet. All values have to be positive or zero, and are used for " \
+           "all time steps.", \
+    "uilabel": "Member throughputs", \
+    "uitype": "oneormore", \
+    "units": "kg/time step", \
+  }
+  std::vector<double> throughputs;
+
+  #pragma cyclus var { \
+    "tooltip": "member inventories", \
+    "doc": "Total amount of material each member has remaining, one entry " \
+           "per member. Every trade decreases the inventories of the " \
+           "members that fill it. If empty, all inventories are " \
+           "unlimited.", \
+    "default": [], \
+    "uilabel": "Member inventories", \
+    "uitype": "oneormore", \
+    "units": "kg", \
+  }
+  std::vector<double> inventories;
+
+  #pragma cyclus var { \
+    "tooltip": "member latitudes", \
+    "doc": "Latitude of each member's geographical position in degrees, " \
+           "one entry per member. If empty, all latitudes are 0.", \
+    "default": [], \
+    "uilabel": "Member latitudes", \
+    "uitype": "oneormore", \
+  }
+  std::vector<double> latitudes;
+
+  #pragma cyclus var { \
+    "tooltip": "member longitudes", \
+    "doc": "Longitude of each member's geographical position in degrees, " \
+           "one entry per member. If empty, all longitudes are 0.", \
+    "default": [], \
+    "uilabel": "Member longitudes", \
+    "uitype": "oneormore", \
+  }
+  std::vector<double> longitudes;
+
+  #pragma cyclus var { \
+    "default": 0, \
+    "userlevel": 10, \
+    "tooltip": "record callback timings", \
+    "uilabel": "Record timings", \
+    "doc": "If true, the wall time spent in each callback of this agent is " \
+           "written to the AgentTimings table at every time step." \
+  }
+  bool record_timings;
+
+  #pragma cyclus var { \
+    "default": 0, \
+    "userlevel": 10, \
+    "tooltip": "record exchange footprint", \
+    "uilabel": "Record exchange footprint", \
+    "doc": "If true, the number of requests, bids, constraints and trades " \
+           "this agent contributed to the exchange is written to the " \
+           "ExchangeFootprint table at every time step." \
+  }
+  bool record_exchange_footprint;
+
+  // Exchange counts of the current time step
+  ExchangeFootprint footprint_;
+
+  // The supply of each member in the current time step and the quantity
+  // it has shipped so far
+  std::vector<double> member_supply_;
+  std::vector<double> member_shipped_;
+
+  // outrecipe's composition, resolved in EnterNotify or on first use, and
+  // the supply time series name
+  cyclus::Composition::Ptr outrecipe_comp_;
+  std::string supply_ts_;
+
+  // backs the scratch containers of GetMatlBids, reset at every Tick
+  MonotonicArena scratch_;
+};
+
+}  // namespace flexmore
+
+#endif  // CYCLUS_FLEXMORE_FLEET_SOURCE_H_
@@ -0,0 +1,275 @@
+#include "fleet_source_tests.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include "cyc_limits.h"
+#include "test_context.h"
+
+using pyne::nucname::id;
+
+namespace flexmore {
+
+namespace {
+
+cyclus::Composition::Ptr FleetRecipe() {
+  cyclus::CompMap m;
+  m[id("u235")] = 0.5;
+  m[id("u238")] = 0.5;
+  return cyclus::Composition::CreateFromMass(m);
+}
+
+}  // namespace
+
+void FleetSourceTest::SetUp() {
+  fleet = new flexmore::FleetSource(tc.get());
+  trader = tc.trader();
+  commod = "commod";
+  recipe_name = "recipe";
+  recipe = FleetRecipe();
+  tc.get()->AddRecipe(recipe_name, recipe);
+  fleet->outcommod = commod;
+  fleet->outrecipe = recipe_name;
+  double vals[] = {1, 0, 2};
+  throughputs(fleet, std::vector<double>(vals, vals + 3));
+}
+
+void FleetSourceTest::TearDown() {
+  delete fleet;
+}
+
+TEST_F(FleetSourceTest, Print) {
+  EXPECT_NO_THROW(std::string s = fleet->str());
+}
+
+// Test that the fleet bids in one portfolio, capped by the summed capacity
+// of its members
+TEST_F(FleetSourceTest, FleetBids) {
+  using cyclus::BidPortfolio;
+  using cyclus::CapacityConstraint;
+  using cyclus::Material;
+  using cyclus::Request;
+
+  cyclus::ExchangeContext<Material> ec;
+  for (int i = 0; i < 4; i++) {
+    ec.AddRequest(Request<Material>::Create(
+        Material::CreateUntracked(1.5, FleetRecipe()), trader, commod));
+  }
+  std::set<BidPortfolio<Material>::Ptr> ports =
+      fleet->GetMatlBids(ec.commod_requests);
+  ASSERT_EQ(1, ports.size());
+
+  BidPortfolio<Material>::Ptr port = *ports.begin();
+  EXPECT_EQ(fleet, port->bidder());
+  EXPECT_EQ(4, port->bids().size());
+  ASSERT_EQ(1, port->constraints().size());
+  EXPECT_EQ(*port->constraints().begin(), CapacityConstraint<Material>(3));
+  std::set<cyclus::Bid<Material>*>::const_iterator b;
+  for (b = port->bids().begin(); b != port->bids().end(); ++b) {
+    EXPECT_DOUBLE_EQ(1.5, (*b)->offer()->quantity());
+    EXPECT_EQ(recipe, (*b)->offer()->comp());
+  }
+}
+
+// Test that trades are shared among the members in proportion to the
+// capacity each has left and charged to their inventories, and that the
+// fleet refuses more than its capacity
+TEST_F(FleetSourceTest, MemberTrades) {
+  using cyclus::BidPortfolio;
+  using cyclus::Material;
+  using cyclus::Request;
+  using cyclus::Trade;
+
+  double invs[] = {10, 10, 10};
+  inventories(fleet, std::vector<double>(invs, invs + 3));
+  cyclus::ExchangeContext<Material> ec;
+  for (int i = 0; i < 2; i++) {
+    ec.AddRequest(Request<Material>::Create(
+        Material::CreateUntracked(1.5, FleetRecipe()), trader, commod));
+  }
+  std::set<BidPortfolio<Material>::Ptr> ports =
+      fleet->GetMatlBids(ec.commod_requests);
+  ASSERT_EQ(1, ports.size());
+
+  std::vector<Trade<Material> > trades;
+  const std::set<cyclus::Bid<Material>*>& bids = (*ports.begin())->bids();
+  std::set<cyclus::Bid<Material>*>::const_iterator b;
+  for (b = bids.begin(); b != bids.end(); ++b) {
+    trades.push_back(Trade<Material>((*b)->request(), *b, 1.5));
+  }
+  std::vector<std::pair<Trade<Material>, Material::Ptr> > responses;
+  fleet->GetMatlTrades(std::vector<Trade<Material> >(1, trades[0]),
+                       responses);
+  ASSERT_EQ(1, responses.size());
+  EXPECT_EQ(recipe, responses[0].second->comp());
+  EXPECT_DOUBLE_EQ(1.5, responses[0].second->quantity());
+  std::vector<double> left = inventories(fleet);
+  EXPECT_DOUBLE_EQ(9.5, left[0]);
+  EXPECT_DOUBLE_EQ(10, left[1]);
+  EXPECT_DOUBLE_EQ(9, left[2]);
+
+  fleet->GetMatlTrades(std::vector<Trade<Material> >(1, trades[1]),
+                       responses);
+  ASSERT_EQ(2, responses.size());
+  left = inventories(fleet);
+  EXPECT_DOUBLE_EQ(9, left[0]);
+  EXPECT_DOUBLE_EQ(10, left[1]);
+  EXPECT_DOUBLE_EQ(8, left[2]);
+
+  // the members have no capacity left in this time step
+  std::vector<Trade<Material> > more(1, trades[0]);
+  EXPECT_THROW(fleet->GetMatlTrades(more, responses), cyclus::ValueError);
+}
+
+// Test that a fleet records one supply row per time step, one FleetSupply
+// row per member and time step and one position row per member, and ships
+// what its members would ship as separate sources
+TEST_F(FleetSourceTest, Simulation) {
+  std::string config =
+      " <outcommod>commod</outcommod> "
+      " <outrecipe>recipe</outrecipe> "
+      " <throughputs> <val>1</val> <val>2</val> </throughputs> "
+      " <latitudes> <val>10</val> <val>20</val> </latitudes> "
+      " <longitudes> <val>-10</val> <val>-20</val> </longitudes> ";
+  int simdur = 2;
+  cyclus::MockSim sim(cyclus::AgentSpec(":flexmore:FleetSource"), config,
+                      simdur);
+  sim.AddRecipe("recipe", FleetRecipe());
+  sim.AddSink("commod").Finalize();
+  int agent = sim.Run();
+
+  std::vector<cyclus::Cond> conds;
+  conds.push_back(cyclus::Cond("AgentId", "==", agent));
+  cyclus::QueryResult qs = sim.db().Query("TimeSeriessupplycommod", &conds);
+  ASSERT_EQ(simdur, qs.rows.size());
+  for (int i = 0; i < simdur; i++) {
+    EXPECT_DOUBLE_EQ(3, qs.GetVal<double>("Value", i));
+  }
+  cyclus::QueryResult qm = sim.db().Query("FleetSupply", &conds);
+  ASSERT_EQ(2 * simdur, qm.rows.size());
+  for (int i = 0; i < qm.rows.size(); i++) {
+    int m = qm.GetVal<int>("Member", i);
+    EXPECT_DOUBLE_EQ(m + 1., qm.GetVal<double>("Supply", i));
+    EXPECT_NEAR(m + 1., qm.GetVal<double>("Shipped", i), 1e-9);
+  }
+  cyclus::QueryResult qp = sim.db().Query("FleetPosition", &conds);
+  ASSERT_EQ(2, qp.rows.size());
+  for (int i = 0; i < qp.rows.size(); i++) {
+    int m = qp.GetVal<int>("Member", i);
+    EXPECT_EQ(10. * (m + 1), qp.GetVal<double>("Latitude", i));
+    EXPECT_EQ(-10. * (m + 1), qp.GetVal<double>("Longitude", i));
+  }
+
+  std::vector<cyclus::Cond> tconds;
+  tconds.push_back(cyclus::Cond("SenderId", "==", agent));
+  cyclus::QueryResult qt = sim.db().Query("Transactions", &tconds);
+  double total = 0;
+  for (int i = 0; i < qt.rows.size(); i++) {
+    std::vector<cyclus::Cond> rconds;
+    rconds.push_back(cyclus::Cond(
+        "ResourceId", "==", qt.GetVal<int>("ResourceId", i)));
+    total += sim.db().Query("Resources", &rconds).GetVal<double>("Quantity");
+  }
+  EXPECT_NEAR(3. * simdur, total, 1e-9);
+}
+
+namespace {
+
+// Sums the quantities agent sent in sim
+double Shipped(cyclus::MockSim* sim, int agent) {
+  std::vector<cyclus::Cond> conds;
+  conds.push_back(cyclus::Cond("SenderId", "==", agent));
+  cyclus::QueryResult qt = sim->db().Query("Transactions", &conds);
+  double total = 0;
+  for (int i = 0; i < qt.rows.size(); i++) {
+    std::vector<cyclus::Cond> rconds;
+    rconds.push_back(cyclus::Cond(
+        "ResourceId", "==", qt.GetVal<int>("ResourceId", i)));
+    total += sim->db().Query("Resources", &rconds).GetVal<double>("Quantity");
+  }
+  return total;
+}
+
+}  // namespace
+
+// Test that every member of a fleet supplies and ships what a Source of
+// the same throughput and inventory does on the same requests
+TEST_F(FleetSourceTest, MatchesSources) {
+  double throughput[] = {1, 2};
+  double inventory[] = {3, 10};
+  int simdur = 4;
+
+  std::vector<double> source_supply;
+  std::vector<double> source_shipped;
+  for (int m = 0; m < 2; m++) {
+    std::stringstream config;
+    config << " <outcommod>commod</outcommod> "
+           << " <outrecipe>recipe</outrecipe> "
+           << " <throughput> <val>" << throughput[m] << "</val> </throughput> "
+           << " <inventory_size>" << inventory[m] << "</inventory_size> ";
+    cyclus::MockSim sim(cyclus::AgentSpec(":flexmore:Source"), config.str(),
+                        simdur);
+    sim.AddRecipe("recipe", FleetRecipe());
+    sim.AddSink("commod").Finalize();
+    int agent = sim.Run();
+
+    std::vector<cyclus::Cond> conds;
+    conds.push_back(cyclus::Cond("AgentId", "==", agent));
+    cyclus::QueryResult qs =
+        sim.db().Query("TimeSeriessupplycommod", &conds);
+    ASSERT_EQ(simdur, qs.rows.size());
+    for (int t = 0; t < simdur; t++) {
+      source_supply.push_back(qs.GetVal<double>("Value", t));
+    }
+    source_shipped.push_back(Shipped(&sim, agent));
+  }
+
+  std::string config =
+      " <outcommod>commod</outcommod> "
+      " <outrecipe>recipe</outrecipe> "
+      " <throughputs> <val>1</val> <val>2</val> </throughputs> "
+      " <inventories> <val>3</val> <val>10</val> </inventories> ";
+  cyclus::MockSim sim(cyclus::AgentSpec(":flexmore:FleetSource"), config,
+                      simdur);
+  sim.AddRecipe("recipe", FleetRecipe());
+  sim.AddSink("commod").Finalize();
+  int agent = sim.Run();
+
+  std::vector<cyclus::Cond> conds;
+  conds.push_back(cyclus::Cond("AgentId", "==", agent));
+  cyclus::QueryResult qm = sim.db().Query("FleetSupply", &conds);
+  ASSERT_EQ(2 * simdur, qm.rows.size());
+  double shipped[] = {0, 0};
+  for (int i = 0; i < qm.rows.size(); i++) {
+    int m = qm.GetVal<int>("Member", i);
+    int t = qm.GetVal<int>("Time", i);
+    EXPECT_NEAR(source_supply[m * simdur + t],
+                qm.GetVal<double>("Supply", i), 1e-9);
+    shipped[m] += qm.GetVal<double>("Shipped", i);
+  }
+  for (int m = 0; m < 2; m++) {
+    EXPECT_NEAR(source_shipped[m], shipped[m], 1e-9);
+  }
+  EXPECT_NEAR(source_shipped[0] + source_shipped[1], Shipped(&sim, agent),
+              1e-9);
+}
+
+} // namespace flexmore
+
+cyclus::Agent* FleetSourceConstructor(cyclus::Context* ctx) {
+  return new flexmore::FleetSource(ctx);
+}
+
+// required to get functionality in cyclus agent unit tests library
+#ifndef CYCLUS_AGENT_TESTS_CONNECTED
+int ConnectAgentTests();
+static int cyclus_agent_tests_connected = ConnectAgentTests();
+#define CYCLUS_AGENT_TESTS_CONNECTED cyclus_agent_tests_connected
+#endif  // CYCLUS_AGENT_TESTS_CONNECTED
+
+INSTANTIATE_TEST_CASE_P(FleetSourceFac, FacilityTests,
+                        Values(&FleetSourceConstructor));
+INSTANTIATE_TEST_CASE_P(FleetSourceFac, AgentTests,
+                        Values(&FleetSourceConstructor));
@@ -0,0 +1,39 @@
+#ifndef FLEXMORE_SRC_FLEET_SOURCE_TESTS_H_
+#define FLEXMORE_SRC_FLEET_SOURCE_TESTS_H_
+#include "fleet_source.h"
+
+#include <gtest/gtest.h>
+
+#include "agent_tests.h"
+#include "context.h"
+#include "exchange_context.h"
+#include "facility_tests.h"
+#include "material.h"
+
+namespace flexmore {
+
+class FleetSourceTest : public ::testing::Test {
+ public:
+  cyclus::TestContext tc;
+  TestFacility* trader;
+  flexmore::FleetSource* fleet;
+  std::string commod, recipe_name;
+  cyclus::Composition::Ptr recipe;
+
+  virtual void SetUp();
+  virtual void TearDown();
+
+  void throughputs(flexmore::FleetSource* f, std::vector<double> vals) {
+    f->throughputs = vals;
+  }
+  void inventories(flexmore::FleetSource* f, std::vector<double> vals) {
+    f->inventories = vals;
+  }
+  std::vector<double> inventories(flexmore::FleetSource* f) {
+    return f->inventories;
+  }
+};
+
+} // namespace flexmore
+
+#endif  // FLEXMORE_SRC_FLEET_SOURCE_TESTS_H_
@@ -0,0 +1,112 @@
+#ifndef FLEXMORE_SRC_INSTRUMENTATION_H_
+#define FLEXMORE_SRC_INSTRUMENTATION_H_
+
+#include <chrono>
+#include <exception>
+#include <string>
+
+#include "cyclus.h"
+#include "perf_counters.h"
+#include "trace.h"
+
+namespace flexmore {
+
+/// @class PhaseTimer
+///
+/// @brief The PhaseTimer times one agent callback with a monotonic clock and
+/// writes the elapsed wall time (in seconds) to the AgentTimings table when
+/// it goes out of scope. A timer that is not enabled does nothing. Every
+/// timer also opens a TraceSpan for the callback, which is recorded whenever
+/// the TraceSink is enabled, and a PerfScope, which accumulates hardware
+/// counters when the PerfCounters are enabled, independent of the timer.
+class PhaseTimer {
+ public:
+  /// @param agent the agent whose callback is timed
+  /// @param phase the name of the callback, e.g. "GetMatlBids"
+  /// @param enabled whether to time and record the callback
+  PhaseTimer(cyclus::Agent* agent, const char* phase, bool enabled)
+      : span_(agent, phase, "callback"),
+        perf_(agent, phase),
+        agent_(agent),
+        phase_(phase),
+        enabled_(enabled) {
+    if (enabled_) {
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+
+  ~PhaseTimer() {
+    // nothing is recorded for callbacks that are left by an exception
+    if (!enabled_ || std::uncaught_exception()) {
+      return;
+    }
+    double elapsed = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start_).count();
+    cyclus::Context* ctx = agent_->context();
+    ctx->NewDatum("AgentTimings")
+        ->AddVal("AgentId", agent_->id())
+        ->AddVal("Prototype", agent_->prototype())
+        ->AddVal("Time", ctx->time())
+        ->AddVal("Phase", std::string(phase_))
+        ->AddVal("Duration", elapsed)
+        ->Record();
+  }
+
+ private:
+  TraceSpan span_;
+  PerfScope perf_;
+  cyclus::Agent* agent_;
+  const char* phase_;
+  bool enabled_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+/// @class ExchangeFootprint
+///
+/// @brief The ExchangeFootprint counts what an agent contributes to the
+/// resource exchange during one time step: the requests it made and saw,
+/// the bids and constraints it added, and the trades it received, answered
+/// and accepted. Record writes the counts to the ExchangeFootprint table.
+struct ExchangeFootprint {
+  ExchangeFootprint() { Reset(); }
+
+  /// @brief zeroes all counts
+  void Reset() {
+    requests_made = 0;
+    requests_seen = 0;
+    bids = 0;
+    constraints = 0;
+    trades_received = 0;
+    trades_answered = 0;
+    trades_accepted = 0;
+  }
+
+  /// @brief records the counts of the current time step for agent
+  void Record(cyclus::Agent* agent) const {
+    cyclus::Context* ctx = agent->context();
+    ctx->NewDatum("ExchangeFootprint")
+        ->AddVal("AgentId", agent->id())
+        ->AddVal("Prototype", agent->prototype())
+        ->AddVal("Time", ctx->time())
+        ->AddVal("RequestsMade", requests_made)
+        ->AddVal("RequestsSeen", requests_seen)
+        ->AddVal("Bids", bids)
+        ->AddVal("Constraints", constraints)
+        ->AddVal("TradesReceived", trades_received)
+        ->AddVal("TradesAnswered", trades_answered)
+        ->AddVal("TradesAccepted", trades_accepted)
+        ->Record();
+  }
+
+  int requests_made;
+  int requests_seen;
+  int bids;
+  int constraints;
+  int trades_received;
+  int trades_answered;
+  int trades_accepted;
+};
+
+}  // namespace flexmore
+
+#endif  // FLEXMORE_SRC_INSTRUMENTATION_H_
@@ -0,0 +1,204 @@
+#ifndef FLEXMORE_SRC_PERF_COUNTERS_H_
+#define FLEXMORE_SRC_PERF_COUNTERS_H_
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "cyclus.h"
+
+namespace flexmore {
+
+/// @class PerfCounters
+///
+/// @brief The PerfCounters read hardware counters (cycles, instructions,
+/// cache misses and branch misses) through Linux perf_event_open and
+/// aggregate them per prototype and callback. They are enabled by setting
+/// the FLEXMORE_PERF_COUNTERS environment variable to an output path ("-"
+/// for stderr); the totals are written there at process exit.
+///
+/// The counters are opened once, for the thread that first uses them, which
+/// is the simulation thread. Counters that cannot be opened (non-Linux
+/// builds, missing PMU, restrictive perf_event_paranoid settings) are
+/// reported as unavailable and the remaining ones keep working.
+class PerfCounters {
+ public:
+  enum { kCycles = 0, kInstructions, kCacheMisses, kBranchMisses, kNum };
+
+  /// @brief counter totals of one prototype and callback
+  struct Totals {
+    Totals() : calls(0) {
+      for (int i = 0; i < kNum; ++i) {
+        values[i] = 0;
+      }
+    }
+    long long calls;
+    long long values[kNum];
+  };
+
+  /// @returns the process-wide counters
+  static PerfCounters& Get() {
+    static PerfCounters counters;
+    return counters;
+  }
+
+  /// @returns true if at least one counter is available
+  static bool Enabled() { return Get().enabled_; }
+
+  /// @brief reads the current values of all counters, unavailable ones
+  /// read as zero
+  void Read(long long* values) const {
+    for (int i = 0; i < kNum; ++i) {
+      values[i] = 0;
+#ifdef __linux__
+      long long v;
+      if (fds_[i] >= 0 && read(fds_[i], &v, sizeof(v)) == sizeof(v)) {
+        values[i] = v;
+      }
+#endif
+    }
+  }
+
+  /// @brief adds counter deltas to the totals of a prototype and callback
+  void Add(const std::string& prototype, const char* phase,
+           const long long* deltas) {
+    Totals& t = totals_[std::make_pair(prototype, std::string(phase))];
+    t.calls++;
+    for (int i = 0; i < kNum; ++i) {
+      t.values[i] += deltas[i];
+    }
+  }
+
+  ~PerfCounters() {
+    if (enabled_) {
+      Dump_();
+    }
+#ifdef __linux__
+    for (int i = 0; i < kNum; ++i) {
+      if (fds_[i] >= 0) {
+        close(fds_[i]);
+      }
+    }
+#endif
+  }
+
+ private:
+  PerfCounters() : enabled_(false) {
+    for (int i = 0; i < kNum; ++i) {
+      fds_[i] = -1;
+    }
+    const char* path = std::getenv("FLEXMORE_PERF_COUNTERS");
+    if (path == NULL || *path == '\0') {
+      return;
+    }
+    path_ = path;
+#ifdef __linux__
+    const unsigned long long configs[kNum] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+    for (int i = 0; i < kNum; ++i) {
+      struct perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = configs[i];
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      fds_[i] = static_cast<int>(
+          syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+      enabled_ = enabled_ || fds_[i] >= 0;
+    }
+#endif
+    if (!enabled_) {
+      std::fprintf(stderr, "flexmore: hardware performance counters are "
+                   "not available, FLEXMORE_PERF_COUNTERS is ignored\n");
+    }
+  }
+
+  PerfCounters(const PerfCounters&);
+  PerfCounters& operator=(const PerfCounters&);
+
+  void Dump_() const {
+    bool to_stderr = path_ == "-";
+    std::FILE* f = to_stderr ? stderr : std::fopen(path_.c_str(), "w");
+    if (f == NULL) {
+      std::fprintf(stderr, "flexmore: could not open counter file '%s'\n",
+                   path_.c_str());
+      return;
+    }
+    static const char* names[kNum] = {"cycles", "instructions",
+                                      "cache_misses", "branch_misses"};
+    std::fprintf(f, "prototype,phase,calls");
+    for (int i = 0; i < kNum; ++i) {
+      std::fprintf(f, ",%s", names[i]);
+    }
+    std::fprintf(f, "\n");
+    std::map<std::pair<std::string, std::string>, Totals>::const_iterator it;
+    for (it = totals_.begin(); it != totals_.end(); ++it) {
+      std::fprintf(f, "%s,%s,%lld", it->first.first.c_str(),
+                   it->first.second.c_str(), it->second.calls);
+      for (int i = 0; i < kNum; ++i) {
+        if (fds_[i] >= 0) {
+          std::fprintf(f, ",%lld", it->second.values[i]);
+        } else {
+          std::fprintf(f, ",n/a");
+        }
+      }
+      std::fprintf(f, "\n");
+    }
+    if (!to_stderr) {
+      std::fclose(f);
+    }
+  }
+
+  bool enabled_;
+  std::string path_;
+  int fds_[kNum];
+  std::map<std::pair<std::string, std::string>, Totals> totals_;
+};
+
+/// @class PerfScope
+///
+/// @brief The PerfScope attributes the hardware counter deltas of a scope to
+/// an agent's prototype and a callback name if the PerfCounters are enabled.
+class PerfScope {
+ public:
+  PerfScope(const cyclus::Agent* agent, const char* phase)
+      : agent_(agent), phase_(phase), enabled_(PerfCounters::Enabled()) {
+    if (enabled_) {
+      PerfCounters::Get().Read(start_);
+    }
+  }
+
+  ~PerfScope() {
+    if (enabled_) {
+      PerfCounters& counters = PerfCounters::Get();
+      long long end[PerfCounters::kNum];
+      counters.Read(end);
+      for (int i = 0; i < PerfCounters::kNum; ++i) {
+        end[i] -= start_[i];
+      }
+      counters.Add(agent_->prototype(), phase_, end);
+    }
+  }
+
+ private:
+  const cyclus::Agent* agent_;
+  const char* phase_;
+  bool enabled_;
+  long long start_[PerfCounters::kNum];
+};
+
+}  // namespace flexmore
+
+#endif  // FLEXMORE_SRC_PERF_COUNTERS_H_
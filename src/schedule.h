@@ -0,0 +1,69 @@
+#ifndef FLEXMORE_SRC_SCHEDULE_H_
+#define FLEXMORE_SRC_SCHEDULE_H_
+
+#include <algorithm>
+#include <vector>
+
+namespace flexmore {
+
+/// @class Schedule
+///
+/// @brief A Schedule is a piecewise-constant, time-dependent value. It
+/// stores runs of equal values instead of one value per time step and
+/// answers value(t) with a binary search over the run starts. Archetypes
+/// keep values() and lengths() as their state, so that a long schedule
+/// with few changes is stored and snapshotted as a few runs.
+class Schedule {
+ public:
+  Schedule() {}
+
+  /// @brief compresses a list of values into runs. Each value holds for
+  /// the number of time steps at the same position of lengths, or for one
+  /// time step if lengths is empty. Adjacent equal values are merged. A
+  /// list with a single element yields a value that is constant in time.
+  explicit Schedule(const std::vector<double>& vals,
+                    const std::vector<int>& lengths = std::vector<int>()) {
+    int t = 0;
+    for (int i = 0; i < vals.size(); i++) {
+      if (values_.empty() || vals[i] != values_.back()) {
+        starts_.push_back(t);
+        values_.push_back(vals[i]);
+        lengths_.push_back(0);
+      }
+      int len = lengths.empty() ? 1 : lengths[i];
+      lengths_.back() += len;
+      t += len;
+    }
+  }
+
+  /// @returns the value at time step t, counted from the start of the
+  /// schedule. Times before the start or after the last run are clamped.
+  double value(int t) const {
+    std::vector<int>::const_iterator it =
+        std::upper_bound(starts_.begin(), starts_.end(), t);
+    if (it == starts_.begin()) {
+      return values_.front();
+    }
+    return values_[it - starts_.begin() - 1];
+  }
+
+  /// @returns the number of runs of equal values
+  inline int nruns() const { return values_.size(); }
+
+  /// @returns the value of each run
+  inline const std::vector<double>& values() const { return values_; }
+
+  /// @returns the number of time steps of each run
+  inline const std::vector<int>& lengths() const { return lengths_; }
+
+  inline bool empty() const { return values_.empty(); }
+
+ private:
+  std::vector<int> starts_;
+  std::vector<double> values_;
+  std::vector<int> lengths_;
+};
+
+}  // namespace flexmore
+
+#endif  // FLEXMORE_SRC_SCHEDULE_H_
@@ -1,7 +1,11 @@
 #include "source.h"
 
+#include <algorithm>
+#include <functional>
 #include <limits>
+#include <map>
 #include <sstream>
+#include <utility>
 
 namespace flexmore {
 
@@ -10,8 +14,12 @@ Source::Source(cyclus::Context* ctx)
     : cyclus::Facility(ctx),
       throughput(std::vector<double>(1, std::numeric_limits<double>::max())),
       inventory_size(std::numeric_limits<double>::max()),
+      max_bids(0),
+      bid_selection("preference"),
       latitude(0.0),
       longitude(0.0),
+      record_timings(false),
+      record_exchange_footprint(false),
       coordinates(0.0, 0.0) {}
 
 Source::~Source() {}
@@ -20,16 +28,20 @@ Source::~Source() {}
 void Source::InitFrom(Source* m) {
   #pragma cyclus impl initfromcopy flexmore::Source
   cyclus::toolkit::CommodityProducer::Copy(m);
+  SetUpCommods_();
   RecordPosition();
 }
 
 void Source::InitFrom(cyclus::QueryableBackend* b) {
   #pragma cyclus impl initfromdb flexmore::Source
   namespace tk = cyclus::toolkit;
-  tk::CommodityProducer::Add(
-    tk::Commodity(outcommod),
-    tk::CommodInfo(currentThroughput, currentThroughput)
-  );
+  SetUpCommods_();
+  for (int i = 0; i < commods_.size(); i++) {
+    tk::CommodityProducer::Add(
+      tk::Commodity(commods_[i]),
+      tk::CommodInfo(currentThroughput, currentThroughput)
+    );
+  }
   RecordPosition();
 }
 
@@ -40,16 +52,27 @@ void Source::EnterNotify() {
   int ltime = lifetime() != -1 ?
       lifetime() : context()->sim_info().duration - enter_time();
   
-  // if only one throughput is indicated, then expand this to all timesteps
-  if (throughput.size() == 1) {
-    throughput = std::vector<double>(ltime, throughput[0]);
-  }
-
-  // input consistency checks
+  // input consistency checks, a single throughput is used for all timesteps
   std::stringstream ss;
-  if (throughput.size() != ltime) {
+  if (!throughput_runs.empty()) {
+    int total = 0;
+    for (int i = 0; i < throughput_runs.size(); i++) {
+      if (throughput_runs[i] <= 0) {
+        ss << "Prototype '" << prototype() << "' has non-positive value "
+           << throughput_runs[i] << " in position " << i
+           << " of throughput_runs\n";
+      }
+      total += throughput_runs[i];
+    }
+    if (throughput_runs.size() != throughput.size() || total != ltime) {
+      ss << "Prototype '" << prototype() << "' has "
+         << throughput_runs.size() << " throughput_runs summing to " << total
+         << ", expected " << throughput.size() << " summing to " << ltime
+         << "\n";
+    }
+  } else if (throughput.size() != 1 && throughput.size() != ltime) {
     ss << "Prototype '" << prototype() << "' has "
-       << throughput.size() << " throughput vals, expected "
+       << throughput.size() << " throughput vals, expected 1 or "
        << ltime << "\n";
   }
   for (int i = 0; i < throughput.size(); i++) {
@@ -60,30 +83,99 @@ void Source::EnterNotify() {
          << " in position " << i << " of throughput\n";
     }
   }
+  if (outcommod.empty() && outcommods.empty()) {
+    ss << "Prototype '" << prototype() << "' has neither outcommod nor "
+       << "outcommods\n";
+  }
+  if (!outrecipes.empty() && outrecipes.size() != outcommods.size()) {
+    ss << "Prototype '" << prototype() << "' has " << outrecipes.size()
+       << " outrecipes, expected 0 or " << outcommods.size() << "\n";
+  }
+  SetUpCommods_();
+  for (int i = 0; i < commods_.size(); i++) {
+    if (CommodIndex_(commods_[i]) != i) {
+      ss << "Prototype '" << prototype() << "' lists output commodity '"
+         << commods_[i] << "' more than once\n";
+    }
+  }
+  if (max_bids < 0) {
+    ss << "Prototype '" << prototype() << "' has negative max_bids "
+       << max_bids << "\n";
+  }
+  if (bid_selection != "preference" && bid_selection != "quantity") {
+    ss << "Prototype '" << prototype() << "' has invalid bid_selection '"
+       << bid_selection << "', expected 'preference' or 'quantity'\n";
+  }
   
   if (ss.str().size() > 0) {
     throw cyclus::ValueError(ss.str());
-  } 
+  }
+  throughput_schedule_ = Schedule(throughput, throughput_runs);
+  if (throughput.size() > 1) {
+    throughput = throughput_schedule_.values();
+    throughput_runs = throughput_schedule_.lengths();
+  }
+  for (int i = 0; i < recipes_.size(); i++) {
+    if (!recipes_[i].empty()) {
+      comps_[i] = context()->GetRecipe(recipes_[i]);
+    }
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Source::SetUpCommods_() {
+  commods_.clear();
+  recipes_.clear();
+  if (!outcommod.empty()) {
+    commods_.push_back(outcommod);
+    recipes_.push_back(outrecipe);
+  }
+  for (int i = 0; i < outcommods.size(); i++) {
+    commods_.push_back(outcommods[i]);
+    recipes_.push_back(i < outrecipes.size() ? outrecipes[i] : "");
+  }
+  comps_.assign(commods_.size(), cyclus::Composition::Ptr());
+  shipped_.assign(commods_.size(), 0);
+  supply_ts_.resize(commods_.size());
+  for (int i = 0; i < commods_.size(); i++) {
+    supply_ts_[i] = "supply" + commods_[i];
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+int Source::CommodIndex_(const std::string& commod) const {
+  for (int i = 0; i < commods_.size(); i++) {
+    if (commods_[i] == commod) {
+      return i;
+    }
+  }
+  return -1;
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 std::string Source::str() {
   namespace tk = cyclus::toolkit;
   std::stringstream ss;
-  std::string ans;
-  
-  if (tk::CommodityProducer::Produces(tk::Commodity(outcommod))) {
-    ans = "yes";
-  } else {
-    ans = "no";
+  if (commods_.empty()) {
+    SetUpCommods_();
+  }
+
+  ss << cyclus::Facility::str() << " at a current throughput of "
+     << currentThroughput << " kg per time step supplies";
+  for (int i = 0; i < commods_.size(); i++) {
+    const std::string& commod = commods_[i];
+    std::string ans;
+    if (tk::CommodityProducer::Produces(tk::Commodity(commod))) {
+      ans = "yes";
+    } else {
+      ans = "no";
+    }
+    ss << " commodity '" << commod << "' with recipe '" << recipes_[i]
+       << "' commod producer members: "
+       << " produces " << commod << "?: " << ans
+       << " throughput: " << tk::CommodityProducer::Capacity(commod)
+       << " cost: " << tk::CommodityProducer::Cost(commod) << ";";
   }
-  
-  ss << cyclus::Facility::str() << " supplies commodity '" << outcommod
-     << "' with recipe '" << outrecipe << "' at a current throughput of"
-     << currentThroughput << " kg per time step commod producer members: "
-     << " produces " << outcommod << "?: " << ans
-     << " throughput: " << tk::CommodityProducer::Capacity(outcommod)
-     << " cost: " << tk::CommodityProducer::Cost(outcommod);
   
   return ss.str();
 }
@@ -91,14 +183,93 @@ std::string Source::str() {
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void Source::SetThroughput() {
   int t = context()->time() - enter_time();
-  currentThroughput = throughput[t];
+  if (throughput_schedule_.empty()) {
+    throughput_schedule_ = Schedule(throughput, throughput_runs);
+  }
+  currentThroughput = throughput_schedule_.value(t);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+cyclus::Composition::Ptr Source::OutComp_(int i,
+                                          cyclus::Material::Ptr target) {
+  if (recipes_[i].empty()) {
+    return target->comp();
+  }
+  if (!comps_[i]) {
+    comps_[i] = context()->GetRecipe(recipes_[i]);
+  }
+  return comps_[i];
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+namespace {
+
+// orders requests by decreasing selection key, ties by position
+struct Candidate {
+  double key;
+  int pos;
+};
+
+bool operator<(const Candidate& a, const Candidate& b) {
+  return a.key > b.key || (a.key == b.key && a.pos < b.pos);
+}
+
+bool ByPosition(const Candidate& a, const Candidate& b) {
+  return a.pos < b.pos;
+}
+
+}  // namespace
+
+void Source::SelectRequests_(
+    const std::vector<cyclus::Request<cyclus::Material>*>& requests,
+    RequestVec* selected) {
+  int n = requests.size();
+  if (max_bids <= 0 || n <= max_bids) {
+    selected->insert(selected->end(), requests.begin(), requests.end());
+    return;
+  }
+
+  bool by_pref = bid_selection != "quantity";
+  std::vector<Candidate, ArenaAllocator<Candidate> > cands(
+      n, Candidate(), ArenaAllocator<Candidate>(&scratch_));
+  for (int i = 0; i < n; i++) {
+    cands[i].key = by_pref ? requests[i]->preference()
+                           : requests[i]->target()->quantity();
+    cands[i].pos = i;
+  }
+  std::nth_element(cands.begin(), cands.begin() + max_bids, cands.end());
+  std::sort(cands.begin(), cands.begin() + max_bids, ByPosition);
+  selected->reserve(selected->size() + max_bids);
+  for (int i = 0; i < max_bids; i++) {
+    selected->push_back(requests[cands[i].pos]);
+  }
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void Source::Tick() {
+  PhaseTimer timer(this, "Tick", record_timings);
+  scratch_.Reset();
   SetThroughput();
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void Source::Tock() {
+  // completes the trace file in the last time step, including this Tock
+  TraceFlush flush(this);
+  PhaseTimer timer(this, "Tock", record_timings);
+  if (commods_.size() > 1) {
+    for (int i = 0; i < commods_.size(); i++) {
+      cyclus::toolkit::RecordTimeSeries<double>(supply_ts_[i], this,
+                                                shipped_[i]);
+      shipped_[i] = 0;
+    }
+  }
+  if (record_exchange_footprint) {
+    footprint_.Record(this);
+  }
+  footprint_.Reset();
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 std::set<cyclus::BidPortfolio<cyclus::Material>::Ptr> Source::GetMatlBids(
     cyclus::CommodMap<cyclus::Material>::type& commod_requests) {
@@ -107,39 +278,76 @@ std::set<cyclus::BidPortfolio<cyclus::Material>::Ptr> Source::GetMatlBids(
   using cyclus::CapacityConstraint;
   using cyclus::Material;
   using cyclus::Request;
+  PhaseTimer timer(this, "GetMatlBids", record_timings);
 
   double max_qty = std::min(currentThroughput, inventory_size);
-  cyclus::toolkit::RecordTimeSeries<double>(
-    "supply" + outcommod, this, max_qty
-  );
+  if (commods_.empty()) {
+    SetUpCommods_();
+  }
+  // with several commodities, the throughput is not attributable to any
+  // one of them before trading; Tock records what each shipped instead
+  if (commods_.size() == 1) {
+    cyclus::toolkit::RecordTimeSeries<double>(supply_ts_[0], this, max_qty);
+  }
   LOG(cyclus::LEV_INFO3, "Source") << prototype() << "is bidding up to "
-                                   << max_qty << " kg of " << outcommod;
+                                   << max_qty << " kg on "
+                                   << commods_.size() << " commodities";
   LOG(cyclus::LEV_INFO5, "Source") << "stats: " << str();
   
   std::set<BidPortfolio<Material>::Ptr> ports;
   if (max_qty < cyclus::eps()) {
     return ports;
-  } else if (commod_requests.count(outcommod) == 0) {
-    return ports;
   }
 
-  BidPortfolio<Material>::Ptr port(new BidPortfolio<Material>());
-  std::vector<Request<Material>*>& requests = commod_requests[outcommod];
-  std::vector<Request<Material>*>::iterator it;
-  for (it = requests.begin(); it != requests.end(); it++) {
-    Request<Material>* req = *it;
-    Material::Ptr target = req->target();
-    double qty = std::min(target->quantity(), max_qty);
-    Material::Ptr m = Material::CreateUntracked(qty, context()->GetRecipe(outrecipe));
-    if (!outrecipe.empty()) {
-      m = Material::CreateUntracked(qty, context()->GetRecipe(outrecipe));
+  // requests for the same quantity and composition share one offer
+  typedef std::pair<double, int> OfferKey;
+  typedef std::pair<const OfferKey, Material::Ptr> Offer;
+  typedef std::map<OfferKey, Material::Ptr, std::less<OfferKey>,
+                   ArenaAllocator<Offer> > OfferMap;
+  OfferMap offers(std::less<OfferKey>(), ArenaAllocator<Offer>(&scratch_));
+
+  // all commodities draw on the same throughput, so their bids go into one
+  // portfolio under one capacity constraint. Cyclus requires the bids of a
+  // portfolio to share a bidder, not a commodity: the exchange translator
+  // takes each bid's commodity from its request.
+  BidPortfolio<Material>::Ptr port;
+  RequestVec selected(ArenaAllocator<Request<Material>*>(&scratch_));
+  for (int i = 0; i < commods_.size(); i++) {
+    cyclus::CommodMap<Material>::type::iterator found =
+        commod_requests.find(commods_[i]);
+    if (found == commod_requests.end()) {
+      continue;
+    }
+    if (!port) {
+      port = BidPortfolio<Material>::Ptr(new BidPortfolio<Material>());
     }
-    port->AddBid(req, m, this);
+
+    std::vector<Request<Material>*>& requests = found->second;
+    footprint_.requests_seen += requests.size();
+    selected.clear();
+    SelectRequests_(requests, &selected);
+    RequestVec::iterator it;
+    for (it = selected.begin(); it != selected.end(); it++) {
+      Request<Material>* req = *it;
+      Material::Ptr target = req->target();
+      double qty = std::min(target->quantity(), max_qty);
+      cyclus::Composition::Ptr comp = OutComp_(i, target);
+      Material::Ptr& m = offers[OfferKey(qty, comp->id())];
+      if (!m) {
+        m = Material::CreateUntracked(qty, comp);
+      }
+      port->AddBid(req, m, this);
+    }
+  }
+  if (!port) {
+    return ports;
   }
 
   CapacityConstraint<Material> cc(max_qty);
   port->AddConstraint(cc);
   ports.insert(port);
+  footprint_.bids += port->bids().size();
+  footprint_.constraints += port->constraints().size();
 
   return ports;
 }
@@ -151,21 +359,31 @@ void Source::GetMatlTrades(
                           cyclus::Material::Ptr> >& responses) {
   using cyclus::Material;
   using cyclus::Trade;
+  PhaseTimer timer(this, "GetMatlTrades", record_timings);
 
+  footprint_.trades_received += trades.size();
+  if (commods_.empty()) {
+    SetUpCommods_();
+  }
   std::vector<cyclus::Trade<cyclus::Material> >::const_iterator it;
   for(it = trades.begin(); it != trades.end(); ++it) {
+    const std::string& commod = it->request->commodity();
+    int i = CommodIndex_(commod);
+    if (i < 0) {
+      throw cyclus::ValueError("Source " + prototype() +
+                               " received a trade for commodity '" + commod +
+                               "' that it does not supply");
+    }
     double qty = it->amt;
     inventory_size -= qty;
+    shipped_[i] += qty;
 
-    Material::Ptr response;
-    if (!outrecipe.empty()) {
-      response = Material::Create(this, qty, context()->GetRecipe(outrecipe));
-    } else {
-      response = Material::Create(this, qty, it->request->target()->comp());
-    }
+    Material::Ptr response =
+        Material::Create(this, qty, OutComp_(i, it->request->target()));
     responses.push_back(std::make_pair(*it, response));
+    footprint_.trades_answered++;
     LOG(cyclus::LEV_INFO5, "Source") << prototype() << " sent an order"
-                                     << " for " << qty << " of " << outcommod;
+                                     << " for " << qty << " of " << commod;
   }
 }
 
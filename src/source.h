@@ -7,6 +7,10 @@
 
 #include "cyclus.h"
 
+#include "arena.h"
+#include "instrumentation.h"
+#include "schedule.h"
+
 namespace flexmore {
 
 /// @class Source
@@ -36,6 +40,8 @@ class Source : public cyclus::Facility,
   public cyclus::toolkit::CommodityProducer,
   public cyclus::toolkit::Position {
   friend class SourceTest;
+  friend class SourceBench;
+  friend class AllocTest;
  public:
   /// Constructor for Source Class
   /// @param ctx the cyclus context for access to simulation-wide parameters
@@ -61,7 +67,7 @@ class Source : public cyclus::Facility,
   virtual void EnterNotify();
   virtual std::string str();
   virtual void Tick();
-  virtual void Tock() {};
+  virtual void Tock();
   
   virtual std::set<cyclus::BidPortfolio<cyclus::Material>::Ptr>
       GetMatlBids(cyclus::CommodMap<cyclus::Material>::type&
@@ -79,10 +85,34 @@ class Source : public cyclus::Facility,
   
   void RecordPosition();
   void SetThroughput();
+
+  /// @brief collects outcommod and outcommods with their recipes into the
+  /// served commodity lists
+  void SetUpCommods_();
+
+  /// @returns the index of commod in the served commodities, or -1
+  int CommodIndex_(const std::string& commod) const;
+
+  /// @returns the composition offered for a request of target on the i-th
+  /// served commodity: its recipe's composition, resolved once, or the
+  /// target's if the recipe is empty
+  cyclus::Composition::Ptr OutComp_(int i, cyclus::Material::Ptr target);
+
+  typedef std::vector<cyclus::Request<cyclus::Material>*,
+                      ArenaAllocator<cyclus::Request<cyclus::Material>*> >
+      RequestVec;
+
+  /// @brief appends to selected the requests to bid on: all of them, or
+  /// the max_bids ones chosen by bid_selection, in their original order
+  void SelectRequests_(
+      const std::vector<cyclus::Request<cyclus::Material>*>& requests,
+      RequestVec* selected);
   
   #pragma cyclus var { \
     "tooltip": "source output commodity", \
-    "doc": "Output commodity on which the source offers material.", \
+    "doc": "Output commodity on which the source offers material. May be " \
+           "empty if outcommods is given.", \
+    "default": "", \
     "uilabel": "Output Commodity", \
     "uitype": "outcommodity", \
   }
@@ -99,6 +129,32 @@ class Source : public cyclus::Facility,
   }
   std::string outrecipe;
 
+  #pragma cyclus var { \
+    "tooltip": "additional output commodities", \
+    "doc": "Further output commodities on which the source offers material. " \
+           "All output commodities share one throughput and inventory, and " \
+           "the source enters the exchange with a single capacity " \
+           "constraint over all of them. With several output commodities, " \
+           "the supply time series of each records what was shipped on it " \
+           "in the time step.", \
+    "default": [], \
+    "uilabel": "Additional Output Commodities", \
+    "uitype": ["oneormore", "outcommodity"], \
+  }
+  std::vector<std::string> outcommods;
+
+  #pragma cyclus var { \
+    "tooltip": "recipes of the additional output commodities", \
+    "doc": "Recipe names provided on each entry of outcommods, in the same " \
+           "order. An empty name provides the requested composition. If " \
+           "the list is empty, all additional commodities provide the " \
+           "requested compositions.", \
+    "default": [], \
+    "uilabel": "Additional Output Recipes", \
+    "uitype": ["oneormore", "outrecipe"], \
+  }
+  std::vector<std::string> outrecipes;
+
   #pragma cyclus var { \
     "doc": "Total amount of material this source has remaining. " \
            "Every trade decreases this value by the supplied material " \
@@ -118,7 +174,8 @@ class Source : public cyclus::Facility,
            "and where each entry of the list is only valid for one time"\
            "step. If there is only one element in the list, then this value"\
            "is used for all timesteps, else, the length of the list has to "\
-           "be identical to the duration of the simulation. Moreover, "\
+           "be identical to the duration of the simulation, unless "\
+           "throughput_runs is given. Moreover, "\
            "all values have to be positive or zero.", \
     "default": [1e299], \
     "uilabel": "Maximum throughput list", \
@@ -127,6 +184,64 @@ class Source : public cyclus::Facility,
   }
   std::vector<double> throughput;
 
+  #pragma cyclus var { \
+    "default": [], \
+    "userlevel": 10, \
+    "tooltip": "time steps of each throughput entry", \
+    "doc": "Number of time steps for which each entry of throughput holds. " \
+           "If given, it has as many entries as throughput and sums to the " \
+           "duration of the simulation. If empty, each entry holds for one " \
+           "time step. A per time step throughput is stored as runs of " \
+           "equal values on entering the simulation.", \
+    "uilabel": "Throughput run lengths", \
+    "uitype": "oneormore", \
+  }
+  std::vector<int> throughput_runs;
+
+  #pragma cyclus var { \
+    "default": 0, \
+    "userlevel": 10, \
+    "tooltip": "maximum number of bids per time step", \
+    "uilabel": "Maximum number of bids", \
+    "doc": "If positive, the source bids on at most this many requests of " \
+           "each output commodity per time step, chosen according to " \
+           "bid_selection. This bounds the number of exchange arcs in " \
+           "markets with far more requests than the source can serve. If " \
+           "zero, the source bids on all requests.", \
+  }
+  int max_bids;
+
+  #pragma cyclus var { \
+    "default": "preference", \
+    "userlevel": 10, \
+    "tooltip": "request selection when max_bids is set", \
+    "uilabel": "Bid selection", \
+    "categorical": ["preference", "quantity"], \
+    "doc": "How the source chooses the requests to bid on if there are more " \
+           "than max_bids: 'preference' picks the requests with the highest " \
+           "request preference, 'quantity' the largest requests. Ties go to " \
+           "the earlier request.", \
+  }
+  std::string bid_selection;
+
+  // throughput and throughput_runs as a schedule
+  Schedule throughput_schedule_;
+
+  // Exchange counts of the current time step
+  ExchangeFootprint footprint_;
+
+  // The served commodities, outcommod (if set) followed by outcommods, with
+  // their recipe names, compositions (resolved in EnterNotify or on first
+  // use), supply time series names and quantities shipped this time step
+  std::vector<std::string> commods_;
+  std::vector<std::string> recipes_;
+  std::vector<cyclus::Composition::Ptr> comps_;
+  std::vector<std::string> supply_ts_;
+  std::vector<double> shipped_;
+
+  // backs the scratch containers of GetMatlBids, reset at every Tick
+  MonotonicArena scratch_;
+
   #pragma cyclus var { \
     "tooltip": "geographical latitude", \
     "doc": "Latitude of the agent's geographical position. The " \
@@ -144,6 +259,27 @@ class Source : public cyclus::Facility,
     "uilabel": "Geographical longitude in degrees as a double", \
   }
   double longitude;
+
+  #pragma cyclus var { \
+    "default": 0, \
+    "userlevel": 10, \
+    "tooltip": "record callback timings", \
+    "uilabel": "Record timings", \
+    "doc": "If true, the wall time spent in each callback of this agent is " \
+           "written to the AgentTimings table at every time step." \
+  }
+  bool record_timings;
+
+  #pragma cyclus var { \
+    "default": 0, \
+    "userlevel": 10, \
+    "tooltip": "record exchange footprint", \
+    "uilabel": "Record exchange footprint", \
+    "doc": "If true, the number of requests, bids, constraints and trades " \
+           "this agent contributed to the exchange is written to the " \
+           "ExchangeFootprint table at every time step." \
+  }
+  bool record_exchange_footprint;
   
   cyclus::toolkit::Position coordinates;
 };
@@ -98,6 +98,100 @@ TEST_F(SourceTest, SingleThroughputInput) {
 
 }
 
+// Test that schedules store runs of equal values and clamp out-of-range
+// times to the first and last run
+TEST_F(SourceTest, ScheduleRuns) {
+  double vals[] = {1, 1, 1, 2, 2, 3};
+  flexmore::Schedule sched(std::vector<double>(vals, vals + 6));
+  EXPECT_EQ(3, sched.nruns());
+  EXPECT_EQ(1., sched.value(-1));
+  EXPECT_EQ(1., sched.value(2));
+  EXPECT_EQ(2., sched.value(3));
+  EXPECT_EQ(3., sched.value(5));
+  EXPECT_EQ(3., sched.value(100));
+
+  flexmore::Schedule constant(std::vector<double>(1, 4.));
+  EXPECT_EQ(1, constant.nruns());
+  EXPECT_EQ(4., constant.value(1000));
+
+  // the runs rebuild the same schedule
+  ASSERT_EQ(3, sched.lengths().size());
+  EXPECT_EQ(3, sched.lengths()[0]);
+  EXPECT_EQ(2, sched.lengths()[1]);
+  EXPECT_EQ(1, sched.lengths()[2]);
+  flexmore::Schedule rebuilt(sched.values(), sched.lengths());
+  for (int t = 0; t < 6; t++) {
+    EXPECT_EQ(vals[t], rebuilt.value(t));
+  }
+}
+
+// Test that a throughput given as runs holds each value for the number of
+// time steps of its run
+TEST_F(SourceTest, ThroughputRuns) {
+  std::string config =
+      " <outcommod>commod</outcommod>  "
+      " <outrecipe>genericRecipe</outrecipe>  "
+      " <throughput> <val>1</val> <val>2</val> </throughput> "
+      " <throughput_runs> <val>2</val> <val>1</val> </throughput_runs> ";
+  int simdur = 3;
+  cyclus::MockSim sim(cyclus::AgentSpec(":flexmore:Source"), config, simdur);
+  sim.AddRecipe("genericRecipe", genericRecipe());
+  sim.AddSink("commod").Finalize();
+  sim.Run();
+
+  cyclus::QueryResult qr = sim.db().Query("TimeSeriessupplycommod", NULL);
+  ASSERT_EQ(3, qr.rows.size());
+  EXPECT_EQ(1., qr.GetVal<double>("Value", 0));
+  EXPECT_EQ(1., qr.GetVal<double>("Value", 1));
+  EXPECT_EQ(2., qr.GetVal<double>("Value", 2));
+}
+
+// Test that callback timings are recorded once per callback and time step
+TEST_F(SourceTest, RecordTimings) {
+  std::string config =
+      " <outcommod>commod</outcommod>  "
+      " <outrecipe>genericRecipe</outrecipe>  "
+      " <record_timings>1</record_timings>  ";
+  int simdur = 2;
+  cyclus::MockSim sim(cyclus::AgentSpec(":flexmore:Source"), config, simdur);
+  sim.AddRecipe("genericRecipe", genericRecipe());
+  sim.AddSink("commod").Finalize();
+  int id = sim.Run();
+
+  std::vector<cyclus::Cond> conds;
+  conds.push_back(cyclus::Cond("Phase", "==", std::string("Tick")));
+  cyclus::QueryResult qr = sim.db().Query("AgentTimings", &conds);
+  EXPECT_EQ(simdur, qr.rows.size());
+  EXPECT_LE(0., qr.GetVal<double>("Duration"));
+
+  conds[0] = cyclus::Cond("Phase", "==", std::string("GetMatlTrades"));
+  qr = sim.db().Query("AgentTimings", &conds);
+  EXPECT_EQ(simdur, qr.rows.size());
+}
+
+// Test that the exchange footprint counts the bids and trades of a source
+TEST_F(SourceTest, ExchangeFootprint) {
+  std::string config =
+      " <outcommod>commod</outcommod>  "
+      " <outrecipe>genericRecipe</outrecipe>  "
+      " <record_exchange_footprint>1</record_exchange_footprint>  ";
+  int simdur = 1;
+  cyclus::MockSim sim(cyclus::AgentSpec(":flexmore:Source"), config, simdur);
+  sim.AddRecipe("genericRecipe", genericRecipe());
+  sim.AddSink("commod").capacity(1).Finalize();
+  sim.AddSink("commod").capacity(1).Finalize();
+  int id = sim.Run();
+
+  cyclus::QueryResult qr = sim.db().Query("ExchangeFootprint", NULL);
+  EXPECT_EQ(1, qr.rows.size());
+  EXPECT_EQ(2, qr.GetVal<int>("RequestsSeen"));
+  EXPECT_EQ(2, qr.GetVal<int>("Bids"));
+  EXPECT_EQ(1, qr.GetVal<int>("Constraints"));
+  EXPECT_EQ(2, qr.GetVal<int>("TradesReceived"));
+  EXPECT_EQ(2, qr.GetVal<int>("TradesAnswered"));
+  EXPECT_EQ(0, qr.GetVal<int>("RequestsMade"));
+}
+
 TEST_F(SourceTest, Print) {
   EXPECT_NO_THROW(std::string s = src_facility->str());
 }
@@ -130,6 +224,200 @@ TEST_F(SourceTest, AddBids) {
   EXPECT_EQ(*constrs.begin(), CapacityConstraint<Material>(capacity));
 }
 
+// Test that requests for equal quantities share one offer
+TEST_F(SourceTest, SharedOffers) {
+  using cyclus::BidPortfolio;
+  using cyclus::Material;
+  using cyclus::Request;
+
+  cyclus::ExchangeContext<Material> ec;
+  double qtys[] = {1, 2, 1, 1, 2};
+  for (int i = 0; i < 5; i++) {
+    ec.AddRequest(Request<Material>::Create(
+        Material::CreateUntracked(qtys[i], recipe), trader, commod));
+  }
+  std::set<BidPortfolio<Material>::Ptr> ports =
+      src_facility->GetMatlBids(ec.commod_requests);
+  ASSERT_EQ(1, ports.size());
+
+  const std::set<cyclus::Bid<Material>*>& bids = (*ports.begin())->bids();
+  EXPECT_EQ(5, bids.size());
+  std::set<Material*> offers;
+  std::set<cyclus::Bid<Material>*>::const_iterator it;
+  for (it = bids.begin(); it != bids.end(); ++it) {
+    offers.insert((*it)->offer().get());
+    EXPECT_EQ(recipe, (*it)->offer()->comp());
+  }
+  EXPECT_EQ(2, offers.size());
+}
+
+// Test that max_bids limits the bids to the requests with the highest
+// preference or quantity
+TEST_F(SourceTest, TopBids) {
+  using cyclus::BidPortfolio;
+  using cyclus::Material;
+  using cyclus::Request;
+
+  cyclus::ExchangeContext<Material> ec;
+  double vals[] = {1, 5, 3, 4, 2};
+  for (int i = 0; i < 5; i++) {
+    ec.AddRequest(Request<Material>::Create(
+        Material::CreateUntracked(vals[i], recipe), trader, commod,
+        vals[4 - i]));
+  }
+
+  std::string selections[] = {"preference", "quantity"};
+  for (int k = 0; k < 2; k++) {
+    max_bids(src_facility, 2, selections[k]);
+    std::set<BidPortfolio<Material>::Ptr> ports =
+        src_facility->GetMatlBids(ec.commod_requests);
+    ASSERT_EQ(1, ports.size());
+
+    const std::set<cyclus::Bid<Material>*>& bids = (*ports.begin())->bids();
+    EXPECT_EQ(2, bids.size());
+    std::set<cyclus::Bid<Material>*>::const_iterator it;
+    for (it = bids.begin(); it != bids.end(); ++it) {
+      Request<Material>* req = (*it)->request();
+      double val = k == 0 ? req->preference() : req->target()->quantity();
+      EXPECT_LE(4, val);
+    }
+  }
+
+  max_bids(src_facility, 0, "preference");
+  std::set<BidPortfolio<Material>::Ptr> ports =
+      src_facility->GetMatlBids(ec.commod_requests);
+  EXPECT_EQ(5, (*ports.begin())->bids().size());
+}
+
+// Test that all output commodities bid into one portfolio under one
+// capacity constraint, each with its own recipe
+TEST_F(SourceTest, MultiCommodityBids) {
+  using cyclus::BidPortfolio;
+  using cyclus::CapacityConstraint;
+  using cyclus::Material;
+  using cyclus::Request;
+
+  std::vector<std::string> commods;
+  commods.push_back("a");
+  commods.push_back("b");
+  std::vector<std::string> recipes;
+  recipes.push_back(recipe_name);
+  recipes.push_back("");
+  outcommods(src_facility, commods, recipes);
+
+  cyclus::ExchangeContext<Material> ec;
+  cyclus::Composition::Ptr target = genericRecipe();
+  std::string all[] = {commod, "a", "b", "other"};
+  for (int i = 0; i < 4; i++) {
+    ec.AddRequest(Request<Material>::Create(
+        Material::CreateUntracked(1, target), trader, all[i]));
+  }
+  std::set<BidPortfolio<Material>::Ptr> ports =
+      src_facility->GetMatlBids(ec.commod_requests);
+  ASSERT_EQ(1, ports.size());
+
+  // all commodities bid in one portfolio under one constraint on the
+  // whole capacity
+  BidPortfolio<Material>::Ptr port = *ports.begin();
+  ASSERT_EQ(3, port->bids().size());
+  ASSERT_EQ(1, port->constraints().size());
+  EXPECT_DOUBLE_EQ(capacity, port->constraints().begin()->capacity());
+
+  std::set<std::string> seen;
+  std::set<cyclus::Bid<Material>*>::const_iterator it;
+  for (it = port->bids().begin(); it != port->bids().end(); ++it) {
+    std::string c = (*it)->request()->commodity();
+    EXPECT_NE("other", c);
+    seen.insert(c);
+    EXPECT_EQ(c == "b" ? target : recipe, (*it)->offer()->comp());
+  }
+  EXPECT_EQ(3, seen.size());
+}
+
+// Test that when the bids on one commodity are not accepted, the other
+// commodities can still ship the whole throughput in the same time step
+TEST_F(SourceTest, MultiCommodityUnaccepted) {
+  using cyclus::BidPortfolio;
+  using cyclus::Material;
+  using cyclus::Request;
+  using cyclus::Trade;
+
+  std::vector<std::string> commods;
+  commods.push_back("a");
+  commods.push_back("b");
+  outcommods(src_facility, commods, std::vector<std::string>());
+
+  cyclus::ExchangeContext<Material> ec;
+  cyclus::Composition::Ptr target = genericRecipe();
+  for (int i = 0; i < 2; i++) {
+    ec.AddRequest(Request<Material>::Create(
+        Material::CreateUntracked(capacity, target), trader, commods[i]));
+  }
+  std::set<BidPortfolio<Material>::Ptr> ports =
+      src_facility->GetMatlBids(ec.commod_requests);
+  ASSERT_EQ(1, ports.size());
+  BidPortfolio<Material>::Ptr port = *ports.begin();
+  ASSERT_EQ(2, port->bids().size());
+  double cap = port->constraints().begin()->capacity();
+
+  // only the bid on a is accepted, for the whole capacity
+  std::vector<Trade<Material> > trades;
+  std::set<cyclus::Bid<Material>*>::const_iterator it;
+  for (it = port->bids().begin(); it != port->bids().end(); ++it) {
+    if ((*it)->request()->commodity() == "a") {
+      trades.push_back(Trade<Material>((*it)->request(), *it,
+                                       (*it)->offer()->quantity()));
+    }
+  }
+  ASSERT_EQ(1, trades.size());
+  EXPECT_LE(trades[0].amt, cap + cyclus::eps());
+
+  std::vector<std::pair<Trade<Material>, Material::Ptr> > responses;
+  src_facility->GetMatlTrades(trades, responses);
+  ASSERT_EQ(1, responses.size());
+  EXPECT_DOUBLE_EQ(capacity, responses[0].second->quantity());
+}
+
+// Test that a source with several output commodities records a supply time
+// series of what each shipped, whose values add up to the throughput, and
+// ships no more than its throughput in total
+TEST_F(SourceTest, MultiCommoditySim) {
+  std::string config =
+      " <outcommods> <val>a</val> <val>b</val> </outcommods> "
+      " <outrecipes> <val>genericRecipe</val> <val>genericRecipe</val> "
+      " </outrecipes> "
+      " <throughput> <val>1</val> </throughput> ";
+  int simdur = 2;
+  cyclus::MockSim sim(cyclus::AgentSpec(":flexmore:Source"), config, simdur);
+  sim.AddRecipe("genericRecipe", genericRecipe());
+  sim.AddSink("a").Finalize();
+  sim.AddSink("b").Finalize();
+  int id = sim.Run();
+
+  cyclus::QueryResult qa = sim.db().Query("TimeSeriessupplya", NULL);
+  cyclus::QueryResult qb = sim.db().Query("TimeSeriessupplyb", NULL);
+  ASSERT_EQ(simdur, qa.rows.size());
+  ASSERT_EQ(simdur, qb.rows.size());
+  for (int t = 0; t < simdur; t++) {
+    EXPECT_NEAR(1., qa.GetVal<double>("Value", t) +
+                        qb.GetVal<double>("Value", t), 1e-9);
+  }
+
+  std::vector<cyclus::Cond> conds;
+  conds.push_back(cyclus::Cond("SenderId", "==", id));
+  cyclus::QueryResult qr = sim.db().Query("Transactions", &conds);
+  double total = 0;
+  for (int i = 0; i < qr.rows.size(); i++) {
+    std::string c = qr.GetVal<std::string>("Commodity", i);
+    EXPECT_TRUE(c == "a" || c == "b");
+    std::vector<cyclus::Cond> rconds;
+    rconds.push_back(cyclus::Cond(
+        "ResourceId", "==", qr.GetVal<int>("ResourceId", i)));
+    total += sim.db().Query("Resources", &rconds).GetVal<double>("Quantity");
+  }
+  EXPECT_NEAR(simdur * 1., total, 1e-9);
+}
+
 TEST_F(SourceTest, Response) {
   using cyclus::Bid;
   using cyclus::Material;
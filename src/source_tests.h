@@ -36,15 +36,34 @@ class SourceTest : public ::testing::Test {
 
   void outrecipe(flexmore::Source* s, std::string recipe) {
     s->outrecipe = recipe;
+    s->commods_.clear();
   }
   void outcommod(flexmore::Source* s, std::string commod) {
     s->outcommod = commod;
+    s->commods_.clear();
+  }
+  void outcommods(flexmore::Source* s, std::vector<std::string> commods,
+                  std::vector<std::string> recipes) {
+    s->outcommods = commods;
+    s->outrecipes = recipes;
+    s->commods_.clear();
+  }
+  std::vector<int> throughput_runs(flexmore::Source* s) {
+    return s->throughput_runs;
   }
   void throughput(flexmore::Source* s, double val) {
     s->throughput = std::vector<double>(1, val);
+    s->throughput_runs.clear();
+    s->throughput_schedule_ = Schedule();
   }
   void throughput(flexmore::Source* s, std::vector<double> val) {
     s->throughput = val;
+    s->throughput_runs.clear();
+    s->throughput_schedule_ = Schedule();
+  }
+  void max_bids(flexmore::Source* s, int n, std::string selection) {
+    s->max_bids = n;
+    s->bid_selection = selection;
   }
 
   boost::shared_ptr<cyclus::ExchangeContext<cyclus::Material> > GetContext(
@@ -0,0 +1,239 @@
+#ifndef FLEXMORE_SRC_TRACE_H_
+#define FLEXMORE_SRC_TRACE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "cyclus.h"
+
+namespace flexmore {
+
+/// @class TraceSink
+///
+/// @brief The TraceSink collects timed spans and writes them as Chrome
+/// trace-event JSON (readable by chrome://tracing and Perfetto). It is
+/// enabled by setting the FLEXMORE_TRACE_FILE environment variable to the
+/// output path; otherwise every call is a no-op.
+///
+/// Each thread appends to its own heap-allocated buffer without locking.
+/// Buffers are registered once per thread on a lock-free list. Flush writes
+/// the buffered events to the file and is called by the agents at the end of
+/// the simulation (see TraceFlush). Events recorded afterwards are written
+/// when the sink is destroyed at exit.
+class TraceSink {
+ public:
+  /// @brief a single complete ("X") trace event
+  struct Event {
+    const char* name;
+    const char* cat;
+    double ts;   // start, in microseconds since the sink was created
+    double dur;  // duration, in microseconds
+    int agent_id;
+    int time;
+  };
+
+  /// @brief the events of one thread, linked into the sink's buffer list
+  struct Buffer {
+    int tid;
+    std::vector<Event> events;
+    std::map<int, std::string> prototypes;
+    Buffer* next;
+  };
+
+  /// @returns the process-wide sink
+  static TraceSink& Get() {
+    static TraceSink sink;
+    return sink;
+  }
+
+  /// @returns true if spans are recorded
+  static bool Enabled() { return Get().enabled_; }
+
+  /// @returns microseconds elapsed since the sink was created
+  double Now() const {
+    return std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - epoch_).count();
+  }
+
+  /// @brief appends an event to the calling thread's buffer
+  /// @param agent the agent the span belongs to, may be NULL
+  void Add(const cyclus::Agent* agent, const char* name, const char* cat,
+           double ts, double dur) {
+    Buffer* buf = LocalBuffer_();
+    Event e = {name, cat, ts, dur, -1, -1};
+    if (agent != NULL) {
+      e.agent_id = agent->id();
+      e.time = agent->context()->time();
+      if (buf->prototypes.count(e.agent_id) == 0) {
+        buf->prototypes[e.agent_id] = agent->prototype();
+      }
+    }
+    buf->events.push_back(e);
+  }
+
+  /// @brief appends the buffered events of all threads to the trace file
+  /// and drops them from the buffers. It must not run concurrently with
+  /// spans on other threads, which holds for the simulation thread.
+  void Flush() {
+    if (!enabled_) {
+      return;
+    }
+    if (file_ == NULL) {
+      file_ = std::fopen(path_.c_str(), "w");
+      if (file_ == NULL) {
+        std::fprintf(stderr, "flexmore: could not open trace file '%s'\n",
+                     path_.c_str());
+        enabled_ = false;
+        return;
+      }
+      std::fprintf(file_, "[");
+    }
+    for (Buffer* buf = head_.load(); buf != NULL; buf = buf->next) {
+      std::vector<Event>::const_iterator it;
+      for (it = buf->events.begin(); it != buf->events.end(); ++it) {
+        std::fprintf(file_, "%s\n{\"name\":\"%s\",\"cat\":\"%s\","
+                     "\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,"
+                     "\"tid\":%d", nwritten_ == 0 ? "" : ",", it->name,
+                     it->cat, it->ts, it->dur, buf->tid);
+        if (it->agent_id >= 0) {
+          std::fprintf(file_, ",\"args\":{\"prototype\":\"");
+          WriteEscaped_(file_, buf->prototypes[it->agent_id]);
+          std::fprintf(file_, "\",\"agent_id\":%d,\"time\":%d}",
+                       it->agent_id, it->time);
+        }
+        std::fprintf(file_, "}");
+        nwritten_++;
+      }
+      buf->events.clear();
+    }
+    std::fflush(file_);
+  }
+
+  ~TraceSink() {
+    Flush();
+    if (file_ != NULL) {
+      std::fprintf(file_, "\n]\n");
+      std::fclose(file_);
+    }
+    Buffer* buf = head_.load();
+    while (buf != NULL) {
+      Buffer* next = buf->next;
+      delete buf;
+      buf = next;
+    }
+  }
+
+ private:
+  TraceSink()
+      : enabled_(false),
+        file_(NULL),
+        nwritten_(0),
+        head_(NULL),
+        ntids_(0),
+        epoch_(std::chrono::steady_clock::now()) {
+    const char* path = std::getenv("FLEXMORE_TRACE_FILE");
+    if (path != NULL && *path != '\0') {
+      path_ = path;
+      enabled_ = true;
+    }
+  }
+
+  TraceSink(const TraceSink&);
+  TraceSink& operator=(const TraceSink&);
+
+  /// @returns the calling thread's buffer, registering it on first use
+  Buffer* LocalBuffer_() {
+    static thread_local Buffer* local = NULL;
+    if (local == NULL) {
+      local = new Buffer();
+      local->tid = ntids_.fetch_add(1);
+      local->next = head_.load();
+      while (!head_.compare_exchange_weak(local->next, local)) {}
+    }
+    return local;
+  }
+
+  static void WriteEscaped_(std::FILE* f, const std::string& s) {
+    for (std::string::const_iterator it = s.begin(); it != s.end(); ++it) {
+      if (*it == '"' || *it == '\\') {
+        std::fputc('\\', f);
+      }
+      std::fputc(*it, f);
+    }
+  }
+
+  bool enabled_;
+  std::string path_;
+  std::FILE* file_;
+  long nwritten_;
+  std::atomic<Buffer*> head_;
+  std::atomic<int> ntids_;
+  std::chrono::steady_clock::time_point epoch_;
+};
+
+/// @class TraceSpan
+///
+/// @brief The TraceSpan records the lifetime of a scope as one trace event
+/// if the TraceSink is enabled. Spans opened inside other spans on the same
+/// thread nest in the trace viewer.
+class TraceSpan {
+ public:
+  /// @param agent the agent doing the work, may be NULL
+  /// @param name the span name, must outlive the process (e.g. a literal)
+  /// @param cat the span category, must outlive the process
+  TraceSpan(const cyclus::Agent* agent, const char* name,
+            const char* cat = "flexmore")
+      : agent_(agent), name_(name), cat_(cat),
+        enabled_(TraceSink::Enabled()), start_(0) {
+    if (enabled_) {
+      start_ = TraceSink::Get().Now();
+    }
+  }
+
+  ~TraceSpan() {
+    if (enabled_) {
+      TraceSink& sink = TraceSink::Get();
+      sink.Add(agent_, name_, cat_, start_, sink.Now() - start_);
+    }
+  }
+
+ private:
+  const cyclus::Agent* agent_;
+  const char* name_;
+  const char* cat_;
+  bool enabled_;
+  double start_;
+};
+
+/// @class TraceFlush
+///
+/// @brief The TraceFlush flushes the TraceSink when it goes out of scope in
+/// the last time step of the simulation, so that the trace is complete when
+/// the simulation ends rather than only at process exit. Declared ahead of
+/// the PhaseTimer of an agent's Tock, it also writes the span of that Tock.
+class TraceFlush {
+ public:
+  explicit TraceFlush(const cyclus::Agent* agent) : agent_(agent) {}
+
+  ~TraceFlush() {
+    if (!TraceSink::Enabled()) {
+      return;
+    }
+    cyclus::Context* ctx = agent_->context();
+    if (ctx->time() == ctx->sim_info().duration - 1) {
+      TraceSink::Get().Flush();
+    }
+  }
+
+ private:
+  const cyclus::Agent* agent_;
+};
+
+}  // namespace flexmore
+
+#endif  // FLEXMORE_SRC_TRACE_H_
@@ -0,0 +1,90 @@
+#ifndef FLEXMORE_SRC_URANIUM_VIEW_H_
+#define FLEXMORE_SRC_URANIUM_VIEW_H_
+
+#include "cyclus.h"
+
+namespace flexmore {
+
+/// The basis in which a UraniumView reads a composition
+enum CompBasis { kMassBasis, kAtomBasis };
+
+/// @brief Selects a composition's mass or atom CompMap by basis
+template <CompBasis B>
+struct BasisMap;
+
+template <>
+struct BasisMap<kMassBasis> {
+  static const cyclus::CompMap& Get(const cyclus::Composition::Ptr& c) {
+    return c->mass();
+  }
+};
+
+template <>
+struct BasisMap<kAtomBasis> {
+  static const cyclus::CompMap& Get(const cyclus::Composition::Ptr& c) {
+    return c->atom();
+  }
+};
+
+/// @class UraniumView
+///
+/// @brief The UraniumView reads the U-235 and U-238 fractions of a
+/// composition in one pass over its CompMap, without the map copies and
+/// normalization that cyclus::toolkit::MatQuery performs. Fractions are
+/// normalized over all nuclides of the composition, as MatQuery's are.
+template <CompBasis B>
+class UraniumView {
+ public:
+  explicit UraniumView(const cyclus::Composition::Ptr& comp) {
+    Read_(BasisMap<B>::Get(comp));
+  }
+
+  explicit UraniumView(const cyclus::Material::Ptr& mat) {
+    Read_(BasisMap<B>::Get(mat->comp()));
+  }
+
+  /// @returns the U-235 fraction
+  inline double u235() const { return u235_; }
+
+  /// @returns the U-238 fraction
+  inline double u238() const { return u238_; }
+
+  /// @returns the U-235 plus U-238 fraction
+  inline double uranium() const { return u235_ + u238_; }
+
+  /// @returns U-235 / (U-235 + U-238), or 0 if there is neither
+  inline double assay() const {
+    double u = u235_ + u238_;
+    return u > 0 ? u235_ / u : 0;
+  }
+
+ private:
+  void Read_(const cyclus::CompMap& cm) {
+    double norm = 0;
+    u235_ = 0;
+    u238_ = 0;
+    cyclus::CompMap::const_iterator it;
+    for (it = cm.begin(); it != cm.end(); ++it) {
+      norm += it->second;
+      if (it->first == 922350000) {
+        u235_ = it->second;
+      } else if (it->first == 922380000) {
+        u238_ = it->second;
+      }
+    }
+    if (norm > 0) {
+      u235_ /= norm;
+      u238_ /= norm;
+    }
+  }
+
+  double u235_;
+  double u238_;
+};
+
+typedef UraniumView<kMassBasis> UraniumMassView;
+typedef UraniumView<kAtomBasis> UraniumAtomView;
+
+}  // namespace flexmore
+
+#endif  // FLEXMORE_SRC_URANIUM_VIEW_H_